@@ -31,6 +31,18 @@ RESOURCES+=res/font.model
 TILES_SRC+=$(wildcard assets/tiles/*.xcf)
 RESOURCES+=$(TILES_SRC:assets/%.xcf=res/%.png)
 
+#-----------------------------------
+# Atlas: sprites, tiles and font, packed at build time.
+# Backgrounds are swapped at each room: they stay in the runtime atlas.
+
+BAKED_MODELS+=$(SPRITES_SRC:assets/%.json=res/%.model)
+BAKED_MODELS+=$(TILES_SRC:assets/%.xcf=res/%.tiles)
+BAKED_MODELS+=res/font.model
+
+RESOURCES+=res/atlas.bin
+res/atlas.bin: $(BIN_HOST)/bakeatlas.exe $(SPRITES_SRC:assets/%.json=res/%.model) $(SPRITES_SRC:assets/%.json=res/%.png) $(TILES_SRC:assets/%.xcf=res/%.png) res/font.model res/font.png
+	$(BIN_HOST)/bakeatlas.exe "$@" $(BAKED_MODELS)
+
 $(BIN)/res/quest.json: assets/quest.ldtk $(BIN_HOST)/packquest.exe $(ROOMS_SRC)
 	@mkdir -p $(dir $@)
 	$(BIN_HOST)/packquest.exe "$<" "$@"
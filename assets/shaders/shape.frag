@@ -0,0 +1,52 @@
+#version 300 es
+
+// distances are computed in view space, mediump isn't enough
+precision highp float;
+
+// must match 'ShapeKind' (see renderer.cpp)
+const float KindLine = 0.0;
+const float KindCircle = 1.0;
+
+// Interpolated values from the vertex shader
+in vec2 pos;
+flat in vec4 ends;
+flat in vec2 params;
+flat in vec4 shapeColor;
+
+// Ouput data
+out vec4 color;
+
+float segmentDistance(vec2 p, vec2 a, vec2 b)
+{
+  vec2 pa = p - a;
+  vec2 ba = b - a;
+  float h = clamp(dot(pa, ba) / max(dot(ba, ba), 1e-8), 0.0, 1.0);
+  return length(pa - ba * h);
+}
+
+float boxOutlineDistance(vec2 p, vec2 minPos, vec2 maxPos)
+{
+  vec2 d = abs(p - (minPos + maxPos) * 0.5) - (maxPos - minPos) * 0.5;
+  return abs(length(max(d, 0.0)) + min(max(d.x, d.y), 0.0));
+}
+
+void main()
+{
+  float dist;
+
+  if(params.y == KindLine)
+    dist = segmentDistance(pos, ends.xy, ends.zw);
+  else if(params.y == KindCircle)
+    dist = abs(length(pos - ends.xy) - ends.z);
+  else
+    dist = boxOutlineDistance(pos, min(ends.xy, ends.zw), max(ends.xy, ends.zw));
+
+  // signed distance to the edge of the stroke, antialiased over one pixel
+  float edge = dist - params.x * 0.5;
+  float pixel = max(fwidth(edge), 1e-5);
+
+  color = shapeColor;
+  color.a *= clamp(0.5 - edge / pixel, 0.0, 1.0);
+}
+
+// vim: syntax=glsl
@@ -0,0 +1,71 @@
+#version 300 es
+
+// Uniforms
+layout(std140) uniform MyUniformBlock
+{
+  vec4 viewTransform; // xy: offset, in view space. zw: scale, view space to clip space
+  vec4 lightOffset; // unused
+};
+
+// positions are stored in 16-bit normalized integers (see renderer.cpp)
+const float PositionRange = 16.0;
+
+// must match 'ShapeKind' (see renderer.cpp)
+const float KindLine = 0.0;
+const float KindCircle = 1.0;
+
+// Attributes: unit quad
+layout(location = 0) in vec2 attr_corner;
+
+// Attributes: one per shape
+layout(location = 1) in vec4 attr_ends; // line: both ends. circle: center, (radius, 0). rect: opposite corners
+layout(location = 2) in vec2 attr_params; // x: thickness, y: kind
+layout(location = 3) in vec4 attr_color;
+
+// Output data; will be interpolated for each fragment
+out vec2 pos; // view space
+flat out vec4 ends;
+flat out vec2 params;
+flat out vec4 shapeColor;
+
+void main()
+{
+  vec2 corner = attr_corner * PositionRange; // in [-1;1]
+
+  // room for half the thickness, and the antialiasing
+  float margin = attr_params.x * 0.5 + 0.1;
+
+  if(attr_params.y == KindLine)
+  {
+    // a quad around the segment, aligned on it
+    vec2 a = attr_ends.xy;
+    vec2 b = attr_ends.zw;
+    float len = length(b - a);
+    vec2 axis = len > 0.0 ? (b - a) / len : vec2(1, 0);
+    vec2 normal = vec2(-axis.y, axis.x);
+    pos = (a + b) * 0.5 + axis * corner.x * (len * 0.5 + margin) + normal * corner.y * margin;
+  }
+  else
+  {
+    vec2 minPos, maxPos;
+
+    if(attr_params.y == KindCircle)
+    {
+      minPos = attr_ends.xy - attr_ends.z;
+      maxPos = attr_ends.xy + attr_ends.z;
+    }
+    else
+    {
+      minPos = min(attr_ends.xy, attr_ends.zw);
+      maxPos = max(attr_ends.xy, attr_ends.zw);
+    }
+
+    pos = mix(minPos - margin, maxPos + margin, corner * 0.5 + 0.5);
+  }
+
+  gl_Position = vec4((pos + viewTransform.xy) * viewTransform.zw, 0, 1);
+  ends = attr_ends;
+  params = attr_params;
+  shapeColor = attr_color;
+}
+// vim: syntax=glsl
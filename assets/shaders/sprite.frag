@@ -0,0 +1,19 @@
+#version 300 es
+
+precision mediump float;
+
+uniform sampler2D DiffuseTextureSampler;
+
+// Interpolated values from the vertex shader
+in vec2 UV;
+in vec3 light;
+
+// Ouput data
+out vec4 color;
+
+void main()
+{
+  color = texture(DiffuseTextureSampler, UV) + vec4(light, 0);
+}
+
+// vim: syntax=glsl
@@ -0,0 +1,43 @@
+#version 300 es
+
+// Uniforms
+layout(std140) uniform MyUniformBlock
+{
+  vec4 viewTransform; // xy: offset, in view space. zw: scale, view space to clip space
+  vec4 lightOffset; // added to the per-instance light
+};
+
+// positions are stored in 16-bit normalized integers (see renderer.cpp)
+const float PositionRange = 16.0;
+
+// sizes are stored in 16-bit integers (see sprite_batch.h)
+const float SizeScale = 256.0;
+
+// Attributes: unit quad
+layout(location = 0) in vec2 attr_corner;
+layout(location = 1) in vec2 attr_cornerUV;
+
+// Attributes: one per sprite
+layout(location = 2) in vec2 attr_pos; // center
+layout(location = 3) in float attr_angle;
+layout(location = 4) in vec2 attr_size;
+layout(location = 5) in vec4 attr_uvRect;
+layout(location = 6) in vec3 attr_light;
+
+// Output data; will be interpolated for each fragment
+out vec2 UV;
+out vec3 light;
+
+void main()
+{
+  vec2 p = attr_corner * PositionRange * 0.5 * (attr_size / SizeScale);
+
+  float c = cos(attr_angle);
+  float s = sin(attr_angle);
+  p = vec2(c * p.x - s * p.y, s * p.x + c * p.y);
+
+  gl_Position = vec4((attr_pos + viewTransform.xy + p) * viewTransform.zw, 0, 1);
+  UV = mix(attr_uvRect.xy, attr_uvRect.zw, attr_cornerUV);
+  light = attr_light + lightOffset.rgb;
+}
+// vim: syntax=glsl
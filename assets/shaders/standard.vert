@@ -1,5 +1,8 @@
 #version 300 es
 
+// positions are stored in 16-bit normalized integers (see renderer.cpp)
+const float PositionRange = 16.0;
+
 // Attributes
 in vec2 vertexPos_model;
 in vec2 vertexUV;
@@ -10,7 +13,7 @@ out vec2 UV;
 
 void main()
 {
-  gl_Position = vec4(vertexPos_model, 0, 1);
+  gl_Position = vec4(vertexPos_model * PositionRange, 0, 1);
   UV = vertexUV;
   vertexPos_world = gl_Position;
 }
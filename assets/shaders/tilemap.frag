@@ -0,0 +1,40 @@
+#version 300 es
+
+precision mediump float;
+
+// Uniforms
+layout(std140) uniform MyUniformBlock
+{
+  vec4 viewTransform;
+  vec4 lightOffset;
+};
+
+uniform sampler2D DiffuseTextureSampler; // the atlas
+uniform highp usampler2D TileIndices; // one texel per tile: palette index + 1, 0 if empty
+uniform highp sampler2D TilePalette; // one texel per palette entry: atlas UV rect
+
+// Interpolated values from the vertex shader
+in highp vec2 worldPos;
+
+// Ouput data
+out vec4 color;
+
+void main()
+{
+  ivec2 cell = ivec2(floor(worldPos));
+
+  if(any(lessThan(cell, ivec2(0))) || any(greaterThanEqual(cell, textureSize(TileIndices, 0))))
+    discard;
+
+  uint index = texelFetch(TileIndices, cell, 0).r;
+
+  if(index == 0u)
+    discard;
+
+  highp vec4 rect = texelFetch(TilePalette, ivec2(int(index) - 1, 0), 0);
+  vec2 UV = mix(rect.xy, rect.zw, fract(worldPos));
+
+  color = texture(DiffuseTextureSampler, UV) + vec4(lightOffset.rgb, 0);
+}
+
+// vim: syntax=glsl
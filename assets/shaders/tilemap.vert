@@ -0,0 +1,25 @@
+#version 300 es
+
+// Uniforms
+layout(std140) uniform MyUniformBlock
+{
+  vec4 viewTransform; // xy: offset, in view space. zw: scale, view space to clip space
+  vec4 lightOffset; // added to the tiles color
+};
+
+// positions are stored in 16-bit normalized integers (see renderer.cpp)
+const float PositionRange = 16.0;
+
+// Attributes: screen-covering quad
+in vec2 attr_pos;
+
+// Output data; will be interpolated for each fragment
+out vec2 worldPos; // in tiles
+
+void main()
+{
+  vec2 pos = attr_pos * PositionRange;
+  gl_Position = vec4(pos, 0, 1);
+  worldPos = pos / viewTransform.zw - viewTransform.xy;
+}
+// vim: syntax=glsl
@@ -6,6 +6,8 @@
 
 #pragma once
 
+#include <cstdint>
+
 #include "span.h"
 
 namespace my
@@ -58,5 +60,57 @@ void sort(Span<T> arr, Lambda less)
     heapify(arr, i, 0, less);
   }
 }
-}
 
+// A sort key, along with the index of the element it was computed from.
+// Sorting these, instead of the elements themselves, avoids moving big structs.
+struct KeyIndex
+{
+  uint64_t key;
+  int index;
+};
+
+// Stable LSD radix sort on 'key', one byte per pass.
+// 'tmp' is scratch space, at least as large as 'arr'.
+inline void radixSort(Span<KeyIndex> arr, Span<KeyIndex> tmp)
+{
+  // all the histograms are built in one go
+  int count[8][256] {};
+
+  for(auto& element : arr)
+    for(int pass = 0; pass < 8; ++pass)
+      ++count[pass][(element.key >> (pass * 8)) & 0xFF];
+
+  auto src = arr.data;
+  auto dst = tmp.data;
+
+  for(int pass = 0; pass < 8; ++pass)
+  {
+    auto& histo = count[pass];
+    const int shift = pass * 8;
+
+    // all the keys have the same byte here: nothing to do
+    if(arr.len == 0 || histo[(src[0].key >> shift) & 0xFF] == arr.len)
+      continue;
+
+    int offset = 0;
+
+    for(auto& n : histo)
+    {
+      const int bucketSize = n;
+      n = offset;
+      offset += bucketSize;
+    }
+
+    for(int i = 0; i < arr.len; ++i)
+      dst[histo[(src[i].key >> shift) & 0xFF]++] = src[i];
+
+    swap(src, dst);
+  }
+
+  if(src != arr.data)
+  {
+    for(int i = 0; i < arr.len; ++i)
+      arr.data[i] = src[i];
+  }
+}
+}
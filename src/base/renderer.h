@@ -21,6 +21,8 @@ struct RenderColor
 
 struct RenderObject
 {
+  // true: positions are in the world, the camera moves them.
+  // false: they're relative to the center of the screen, the camera is ignored.
   bool useWorldRefFrame;
   int zOrder;
 };
@@ -42,19 +44,37 @@ struct RenderText : RenderObject
   String text;
 };
 
+// Lines, circles and rects are outlines. Their thickness is in world units.
 struct RenderCircle : RenderObject
 {
   Vec2f pos;
   float radius;
   RenderColor color;
+  float thickness = 0.1;
 };
 
 struct RenderLine : RenderObject
 {
   Vec2f a, b;
   RenderColor color;
-  float thicknessMin = 1;
-  float thicknessMax = 1;
+  float thickness = 0.1;
+};
+
+// Axis-aligned, between two opposite corners
+struct RenderRect : RenderObject
+{
+  Vec2f pos[2];
+  RenderColor color;
+  float thickness = 0.1;
+};
+
+// A grid of unit-sized tiles, the bottom-left one at (0;0), in the world reference frame.
+struct RenderTileLayer
+{
+  int modelId;
+  int zOrder;
+  Vec2i size; // in tiles
+  Span<const int> tiles; // the action index of each tile, row by row. -1 means empty.
 };
 
 struct IRenderer
@@ -62,7 +82,7 @@ struct IRenderer
   virtual ~IRenderer() = default;
 
   virtual void loadModel(int id, String imagePath) = 0;
-  virtual void setCamera(Vec2f pos, bool teleport) = 0;
+  virtual void setCamera(Vec2f pos) = 0;
   virtual void setAmbientLight(float ambientLight) = 0;
 
   // draw functions
@@ -72,5 +92,11 @@ struct IRenderer
   virtual void drawText(const RenderText& text) = 0;
   virtual void drawCircle(const RenderCircle& circle) = 0;
   virtual void drawLine(const RenderLine& line) = 0;
+  virtual void drawRect(const RenderRect& rect) = 0;
+
+  // Static geometry: the layer is uploaded once, replacing the previous one.
+  // Then, 'drawTileLayer' draws it in the current frame.
+  virtual void loadTileLayer(const RenderTileLayer& layer) = 0;
+  virtual void drawTileLayer() = 0;
 };
 
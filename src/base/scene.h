@@ -31,7 +31,9 @@ struct Scene
   // returns the next scene
   virtual Scene* tick(Control c) = 0;
 
-  // ask the scene to send its actors for rendering
-  virtual void draw() = 0;
+  // ask the scene to send its actors for rendering.
+  // 'alpha' is in [0 .. 1]: where the display frame lies, in time,
+  // between the previous tick and the last one.
+  virtual void draw(float alpha) = 0;
 };
 
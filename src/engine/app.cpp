@@ -10,7 +10,10 @@
 
 #include "app.h"
 
+#include <cstdlib> // atoi
+#include <functional>
 #include <memory>
+#include <mutex>
 #include <string>
 #include <vector>
 
@@ -20,6 +23,8 @@
 #include "base/renderer.h"
 #include "base/scene.h"
 #include "misc/file.h"
+#include "misc/math.h" // seedRandom
+#include "misc/replay.h"
 #include "misc/stats.h"
 #include "misc/time.h"
 
@@ -27,12 +32,15 @@
 #include "graphics_backend.h"
 #include "input.h"
 #include "ratecounter.h"
+#include "tick_scheduler.h"
 #include "video_capture.h"
 
 auto const CAPTURE_FRAME_PERIOD = 40;
 
 IGraphicsBackend* createGraphicsBackend(Vec2i resolution);
 IRenderer* createRenderer(IGraphicsBackend* gfxBackend, Vec2i internalResolution);
+IRenderer* createThreadedRenderer(IGraphicsBackend* gfxBackend, std::function<IRenderer* ()> createRenderer);
+IRenderer* createRecordingRenderer(IRenderer* renderer, String path, Vec2i resolution);
 MixableAudio* createAudio();
 UserInput* createUserInput();
 
@@ -40,6 +48,8 @@ Gauge ggFps("FPS");
 Gauge ggTps("TPS");
 Gauge ggTicksPerFrame("Ticks/Frame");
 Gauge ggTickDuration("Tick duration");
+Gauge ggDroppedTicks("Dropped ticks");
+Gauge ggDeferredTicks("Deferred ticks");
 
 // Implemented by the game-specific part
 Scene* createGame(IRenderer* renderer, Audio* audio, Span<const std::string> argv);
@@ -50,34 +60,77 @@ extern const Vec2i INTERNAL_RESOLUTION;
 class App : public IApp, private IScreenSizeListener
 {
 public:
-  App(Span<char*> args) : m_args({ args.data, args.data + args.len })
+  App(Span<char*> args)
   {
+    parseArgs(args);
+
     m_graphicsBackend.reset(createGraphicsBackend(INTERNAL_RESOLUTION * 4));
     m_graphicsBackend->setScreenSizeListener(this);
-    m_renderer.reset(createRenderer(m_graphicsBackend.get(), INTERNAL_RESOLUTION));
+    m_refreshRate = m_graphicsBackend->getRefreshRate();
+
+    if(m_refreshRate <= 0)
+      m_refreshRate = 60;
+
+    if(!m_graphicsBackend->setVsync(m_vsync) && m_vsync)
+    {
+      logMsg("[display] vsync not available, falling back on a timer");
+      m_vsync = false;
+    }
+
+    auto backend = m_graphicsBackend.get();
+
+    if(m_renderThread)
+      m_renderer.reset(createThreadedRenderer(backend, [backend] () { return createRenderer(backend, INTERNAL_RESOLUTION); }));
+    else
+      m_renderer.reset(createRenderer(backend, INTERNAL_RESOLUTION));
+
+    if(!m_renderLogPath.empty())
+      m_renderer.reset(createRecordingRenderer(m_renderer.release(), m_renderLogPath, INTERNAL_RESOLUTION));
+
     m_audio.reset(createAudio());
     m_audioBackend.reset(createAudioBackend(m_audio.get()));
     m_input.reset(createUserInput());
 
     m_graphicsBackend->setCaption(GAME_NAME);
 
+    setupReplay();
+
     m_scene.reset(createGame(m_renderer.get(), m_audio.get(), m_args));
 
-    m_lastTime = GetSteadyClockMs();
+    m_scheduler.reset(GetSteadyClockMs());
     m_lastDisplayFrameTime = GetSteadyClockMs();
 
     registerUserInputActions();
     logMsg("Engine successfully inited");
   }
 
+  ~App()
+  {
+    if(m_replayRecorder)
+    {
+      auto& replay = m_replayRecorder->finish();
+      auto data = serializeReplay(replay);
+      File::write(m_recordPath, data);
+      logMsg("Replay saved to '%s' (%d ticks, %d bytes)", m_recordPath.c_str(), replay.tickCount, (int)data.size());
+    }
+
+    // the renderer uses the graphics backend
+    m_scene.reset();
+    m_renderer.reset();
+  }
+
+  // called by 'swap': on the render thread, when there's one
   void onScreenSizeChanged(Vec2i size, Rect2i viewport) override
   {
+    std::unique_lock<std::mutex> lock(m_screenSizeMutex);
     m_screenSize = size;
     m_viewport = viewport;
   }
 
   bool tick() override
   {
+    m_frameStartTime = GetSteadyClockUs();
+
     m_input->process();
 
     auto const now = (int)GetSteadyClockMs();
@@ -99,7 +152,74 @@ public:
     return m_running != AppState::Exit;
   }
 
+  int64_t nextFrameTime() override
+  {
+    // With vsync, 'swap' already waited for the next display refresh: this
+    // deadline has passed. It's still an upper bound, in case 'swap' doesn't
+    // block (some drivers, hidden or minimized windows): the loop can't spin.
+    return m_frameStartTime + 1000000 / m_refreshRate;
+  }
+
 private:
+  void parseArgs(Span<char*> args)
+  {
+    for(int i = 0; i < args.len; ++i)
+    {
+      std::string arg = args[i];
+
+      if(arg == "--record" && i + 1 < args.len)
+        m_recordPath = args[++i];
+      else if(arg == "--replay" && i + 1 < args.len)
+        m_replayPath = args[++i];
+      else if(arg == "--record-render" && i + 1 < args.len)
+        m_renderLogPath = args[++i];
+      else if(arg == "--no-vsync")
+        m_vsync = false;
+      else if(arg == "--render-thread")
+        m_renderThread = true;
+      else if(arg == "--max-ticks-per-frame" && i + 1 < args.len)
+        m_scheduler.maxTicksPerFrame = atoi(args[++i]);
+      else if(arg == "--tick-budget" && i + 1 < args.len)
+        m_scheduler.tickBudgetMs = atoi(args[++i]);
+      else if(arg == "--max-debt-ticks" && i + 1 < args.len)
+        m_scheduler.maxDebtTicks = atoi(args[++i]);
+      else
+        m_args.push_back(arg);
+    }
+  }
+
+  // A replay only makes sense if it starts from the same level,
+  // with the same RNG seed.
+  // By convention, a single remaining argument is the starting level.
+  void setupReplay()
+  {
+    auto seed = (uint32_t)GetSteadyClockMs();
+
+    if(!m_replayPath.empty())
+    {
+      auto data = File::read(m_replayPath);
+      m_replay = deserializeReplay({ (const uint8_t*)data.data(), (int)data.size() });
+      m_replayPlayer = std::make_unique<ReplayPlayer>(m_replay);
+      seed = m_replay.seed;
+
+      m_args.clear();
+
+      if(m_replay.level >= 0)
+        m_args.push_back(std::to_string(m_replay.level));
+
+      logMsg("Replaying '%s' (%d ticks)", m_replayPath.c_str(), m_replay.tickCount);
+    }
+
+    if(!m_recordPath.empty())
+    {
+      const int level = m_args.size() == 1 ? atoi(m_args[0].c_str()) : -1;
+      m_replayRecorder = std::make_unique<ReplayRecorder>(level, seed);
+      logMsg("Recording to '%s'", m_recordPath.c_str());
+    }
+
+    seedRandom(seed);
+  }
+
   void tickOneDisplayFrame(int now)
   {
     auto freq = GAMEPLAY_HZ;
@@ -110,32 +230,35 @@ private:
     if(m_slowMotion)
       freq /= 10;
 
-    int ticksPerFrame = 0;
+    m_scheduler.beginFrame(now);
 
-    while(1)
-    {
-      const auto nextTime = m_lastTime + (1000 + m_lastRemainder) / freq;
-
-      if(nextTime >= now)
-        break;
-
-      m_lastTime = nextTime;
-      m_lastRemainder = (1000 + m_lastRemainder) % freq;
+    // during video capture, 'now' isn't the wall clock: don't check the tick budget
+    auto clock = [&] () { return m_fixedDisplayFramePeriod ? now : (int)GetSteadyClockMs(); };
 
+    while(m_scheduler.nextTick(freq, clock()))
+    {
       if(!m_paused && m_running == AppState::Running)
       {
         tickGameplay();
         m_tps.tick(now);
         ggTps = m_tps.slope();
       }
-
-      ++ticksPerFrame;
     }
 
-    ggTicksPerFrame = ticksPerFrame;
+    m_scheduler.endFrame(freq);
+
+    ggTicksPerFrame = m_scheduler.ticks;
+    ggDroppedTicks = m_scheduler.droppedTicks;
+    ggDeferredTicks = m_scheduler.deferredTicks;
+
+    // the display frame usually falls between two ticks
+    float alpha = 1.0f;
+
+    if(!m_paused && m_running == AppState::Running)
+      alpha = m_scheduler.alpha(freq);
 
     // draw the frame
-    draw();
+    draw(alpha);
 
     m_fps.tick(now);
     ggFps = m_fps.slope();
@@ -145,6 +268,16 @@ private:
   {
     m_control.debug = m_debugMode;
 
+    if(m_replayPlayer && !m_replayPlayer->next(m_control))
+    {
+      logMsg("End of replay");
+      m_replayPlayer.reset();
+      m_control = {};
+    }
+
+    if(m_replayRecorder)
+      m_replayRecorder->record(m_control);
+
     auto const t0 = GetSteadyClockMs();
 
     m_scene->tick(m_control);
@@ -159,7 +292,7 @@ private:
     m_input->listenToQuit([&]() { m_running = AppState::Exit; });
 
     m_input->listenToKey(Key::F12, [&](bool isDown) { if(isDown) toggleVideoCapture(); }, true);
-    m_input->listenToKey(Key::F12, [&](bool isDown) { if(isDown) m_recorder.takeScreenshot(); }, false);
+    m_input->listenToKey(Key::F12, [&](bool isDown) { if(isDown) takeScreenshot(); }, false);
     m_input->listenToKey(Key::Return, [&](bool isDown) { if(isDown) toggleFullScreen(); }, false, true);
 
     m_input->listenToKey(Key::Y, [&](bool isDown) { if(isDown && m_running == AppState::ConfirmExit) m_running = AppState::Exit; });
@@ -188,11 +321,11 @@ private:
     m_input->listenToKey(Key::Pause, [&](bool isDown) { if(isDown){ togglePause(); } });
   }
 
-  void draw()
+  void draw(float alpha)
   {
     m_renderer->beginDraw();
 
-    m_scene->draw();
+    m_scene->draw(alpha);
 
     if(m_running == AppState::ConfirmExit)
     {
@@ -238,7 +371,18 @@ private:
 
     m_renderer->endDraw();
 
-    m_recorder.captureDisplayFrameIfNeeded(m_graphicsBackend.get(), m_screenSize);
+    // the render thread owns the graphics context: no readback from here
+    if(!m_renderThread)
+    {
+      Vec2i screenSize;
+
+      {
+        std::unique_lock<std::mutex> lock(m_screenSizeMutex);
+        screenSize = m_screenSize;
+      }
+
+      m_recorder.captureDisplayFrameIfNeeded(m_graphicsBackend.get(), screenSize);
+    }
   }
 
   void onQuit()
@@ -249,8 +393,25 @@ private:
       m_running = AppState::ConfirmExit;
   }
 
+  void takeScreenshot()
+  {
+    if(m_renderThread)
+    {
+      logMsg("Can't take screenshots when using a render thread");
+      return;
+    }
+
+    m_recorder.takeScreenshot();
+  }
+
   void toggleVideoCapture()
   {
+    if(m_renderThread)
+    {
+      logMsg("Can't capture video when using a render thread");
+      return;
+    }
+
     if(m_fullscreen)
     {
       logMsg("Can't capture video in fullscreen mode");
@@ -309,14 +470,28 @@ private:
 
   bool m_debugMode = false;
 
-  int m_lastTime;
-  int m_lastRemainder = 0;
+  // frame pacing: 'swap' blocks until the next display refresh (vsync, the default),
+  // and the main loop sleeps until it's time for the next frame anyway (see 'nextFrameTime').
+  bool m_vsync = true;
+  int m_refreshRate = 60;
+  int64_t m_frameStartTime = 0;
+
+  // the graphics context is owned by a dedicated thread (see threaded_renderer.cpp)
+  bool m_renderThread = false;
+
+  TickScheduler m_scheduler;
 
   int m_lastDisplayFrameTime;
   RateCounter m_fps;
   RateCounter m_tps;
   Control m_control{};
   std::vector<std::string> m_args;
+  std::string m_recordPath;
+  std::string m_replayPath;
+  Replay m_replay;
+  std::unique_ptr<ReplayRecorder> m_replayRecorder;
+  std::unique_ptr<ReplayPlayer> m_replayPlayer;
+  std::string m_renderLogPath; // see render_log.h
   bool m_slowMotion = false;
   bool m_fastForward = false;
   bool m_fullscreen = false;
@@ -329,7 +504,8 @@ private:
 
   std::unique_ptr<Scene> m_scene;
 
-  Vec2i m_screenSize{};
+  std::mutex m_screenSizeMutex;
+  Vec2i m_screenSize{}; // protected by 'm_screenSizeMutex'
   Rect2i m_viewport{};
 };
 
@@ -13,6 +13,10 @@ struct IApp
 {
   virtual ~IApp() = default;
   virtual bool tick() = 0;
+
+  // when 'tick' should be called next (see GetSteadyClockUs).
+  // 0 means 'as soon as possible'.
+  virtual int64_t nextFrameTime() = 0;
 };
 
 std::unique_ptr<IApp> createApp(Span<char*> args);
@@ -28,11 +28,21 @@ struct IGpuProgram
   virtual ~IGpuProgram() = default;
 };
 
+enum class TextureFormat
+{
+  Rgba8,
+  R16ui, // integers, only readable with 'texelFetch'
+  Rgba32f, // not filterable
+};
+
 struct ITexture
 {
   virtual ~ITexture() = default;
-  virtual void create(Vec2i size) = 0;
+  virtual void create(Vec2i size, TextureFormat format = TextureFormat::Rgba8) = 0;
   virtual void upload(PictureView srcPic, Vec2i dstPos = {}) = 0;
+
+  // texels in the texture format, bottom row first
+  virtual void uploadRaw(const void* texels, Vec2i dim, Vec2i dstPos = {}) = 0;
   virtual void setNoRepeat() = 0;
   virtual void bind(int unit) = 0;
 };
@@ -41,6 +51,10 @@ struct IVertexBuffer
 {
   virtual ~IVertexBuffer() = default;
   virtual void upload(const void* data, size_t len) = 0;
+
+  // streaming: writes 'vertexCount' vertices after the previously appended ones,
+  // without waiting for the GPU. Returns the index of the first written vertex.
+  virtual int append(const void* data, int vertexCount, int vertexSize) = 0;
 };
 
 struct IFrameBuffer
@@ -49,6 +63,16 @@ struct IFrameBuffer
   virtual ITexture* getColorTexture() = 0;
 };
 
+// component type of a vertex attribute, as stored in the vertex buffer
+enum class AttributeType
+{
+  Float,
+  Short,
+  UnsignedShort,
+  Byte,
+  UnsignedByte,
+};
+
 struct IGraphicsBackend
 {
   virtual ~IGraphicsBackend() = default;
@@ -56,6 +80,14 @@ struct IGraphicsBackend
   virtual void setFullscreen(bool fs) = 0;
   virtual void setCaption(String caption) = 0;
   virtual void enableGrab(bool enable) = 0;
+  // returns false if the driver refused the swap interval
+  virtual bool setVsync(bool enable) = 0;
+
+  // binds the graphics context to the calling thread (or unbinds it)
+  virtual void makeCurrent(bool current) = 0;
+
+  // in Hz, 0 if unknown
+  virtual int getRefreshRate() = 0;
 
   virtual void readPixels(Span<uint8_t> dstRgbPixels) = 0;
 
@@ -64,15 +96,23 @@ struct IGraphicsBackend
   virtual std::unique_ptr<IFrameBuffer> createFrameBuffer(Vec2i resolution, bool depth = true) = 0;
   virtual std::unique_ptr<IGpuProgram> createGpuProgram(String name, bool zTest) = 0;
 
+  // makes the sampler uniform 'name' read from texture unit 'unit'
+  virtual void setSamplerUnit(IGpuProgram* program, String name, int unit) = 0;
+
   virtual void setScreenSizeListener(IScreenSizeListener* listener) = 0;
 
   // draw functions
   virtual void setRenderTarget(IFrameBuffer* fb) = 0;
   virtual void useGpuProgram(IGpuProgram* program) = 0;
   virtual void useVertexBuffer(IVertexBuffer* vb) = 0;
-  virtual void enableVertexAttribute(int id, int dim, int stride, int offset) = 0;
+  // 'normalized': integer components are mapped to [0;1] (unsigned) or [-1;1] (signed)
+  virtual void enableVertexAttribute(int id, int dim, int stride, int offset, AttributeType type = AttributeType::Float, bool normalized = false) = 0;
+
+  // same as above, but the attribute advances once per instance instead of once per vertex
+  virtual void enableInstanceAttribute(int id, int dim, int stride, int offset, AttributeType type = AttributeType::Float, bool normalized = false) = 0;
   virtual void setUniformBlock(void* ptr, size_t size) = 0;
-  virtual void draw(int vertexCount) = 0;
+  virtual void draw(int vertexCount, int firstVertex = 0) = 0;
+  virtual void drawInstanced(int vertexCount, int instanceCount) = 0;
   virtual void clear() = 0;
   virtual void swap() = 0;
 };
@@ -9,6 +9,8 @@
 
 #include "base/error.h"
 #include "base/logger.h"
+#include "misc/stats.h"
+#include "misc/time.h"
 
 #include "app.h"
 
@@ -33,10 +35,36 @@ void runMainLoop(IApp* app)
 
 #else
 
+Gauge ggWakeups("Wakeups/s");
+Gauge ggIdle("Idle %");
+
 void runMainLoop(IApp* app)
 {
+  int64_t periodStart = GetSteadyClockUs();
+  int64_t idleTime = 0;
+  int wakeups = 0;
+
   while(app->tick())
-    SDL_Delay(1);
+  {
+    auto const t0 = GetSteadyClockUs();
+    SleepUntilUs(app->nextFrameTime());
+    auto const t1 = GetSteadyClockUs();
+
+    idleTime += t1 - t0;
+    ++wakeups;
+
+    auto const elapsed = t1 - periodStart;
+
+    if(elapsed >= 1000000)
+    {
+      ggWakeups = wakeups * 1000000.0 / elapsed;
+      ggIdle = idleTime * 100.0 / elapsed;
+
+      periodStart = t1;
+      idleTime = 0;
+      wakeups = 0;
+    }
+  }
 }
 
 #endif
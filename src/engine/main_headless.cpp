@@ -0,0 +1,404 @@
+// Copyright (C) 2023 - Sebastien Alaiwan
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as
+// published by the Free Software Foundation, either version 3 of the
+// License, or (at your option) any later version.
+
+// Entry point of the headless build.
+// Runs the gameplay as fast as possible, without any window, GL context
+// or audio device, and reports timing statistics.
+//
+// Usage: headless.exe [options] [level]
+//   --ticks N       number of gameplay ticks to run (default: 10000)
+//   --replay FILE   feed a recorded input stream (see misc/replay.h)
+//   --levels A-B    batch mode: run one simulation per level
+//   --runs N        batch mode: run N simulations with random inputs
+//   --jobs N        number of simulations run in parallel (default: one per core)
+//
+// Simulations are independent: each one runs on its own thread,
+// with its own game state. Only the quest data is shared.
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib> // atoi
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "base/audio.h"
+#include "base/error.h"
+#include "base/logger.h"
+#include "base/renderer.h"
+#include "base/scene.h"
+#include "misc/file.h"
+#include "misc/math.h" // seedRandom
+#include "misc/replay.h"
+#include "misc/stats.h"
+
+// Implemented by the game-specific part
+Scene* createGame(IRenderer* renderer, Audio* audio, Span<const std::string> argv);
+
+namespace
+{
+struct NullRenderer : IRenderer
+{
+  void loadModel(int, String) override {}
+  void setCamera(Vec2f) override {}
+  void setAmbientLight(float) override {}
+
+  void beginDraw() override {}
+  void endDraw() override { ++frames; }
+  void drawSprite(const RenderSprite&) override { ++sprites; }
+  void drawText(const RenderText&) override { ++texts; }
+  void drawCircle(const RenderCircle&) override { ++circles; }
+  void drawLine(const RenderLine&) override { ++lines; }
+  void drawRect(const RenderRect&) override { ++rects; }
+  void loadTileLayer(const RenderTileLayer&) override {}
+  void drawTileLayer() override {}
+
+  int64_t frames = 0;
+  int64_t sprites = 0;
+  int64_t texts = 0;
+  int64_t circles = 0;
+  int64_t lines = 0;
+  int64_t rects = 0;
+};
+
+struct NullAudio : Audio
+{
+  void loadSound(int, String) override {}
+  VoiceId createVoice() override { return 0; }
+  void releaseVoice(VoiceId, bool) override {}
+  void playVoice(VoiceId, int, bool) override { ++sounds; }
+  void stopVoice(VoiceId) override {}
+  void setVoiceVolume(VoiceId, float) override {}
+
+  int64_t sounds = 0;
+};
+
+// Mashes buttons: the pressed buttons change every few ticks.
+struct RandomInput
+{
+  RandomInput(uint32_t seed) : m_state(seed ? seed : 1) {}
+
+  Control next(int tick)
+  {
+    if(tick % 20 == 0)
+    {
+      // xorshift32
+      m_state ^= m_state << 13;
+      m_state ^= m_state >> 17;
+      m_state ^= m_state << 5;
+
+      m_control.left = m_state & 1;
+      m_control.right = (m_state & 2) && !m_control.left;
+      m_control.up = m_state & 4;
+      m_control.down = m_state & 8;
+      m_control.fire = m_state & 16;
+      m_control.jump = m_state & 32;
+      m_control.dash = m_state & 64;
+    }
+
+    return m_control;
+  }
+
+private:
+  uint32_t m_state;
+  Control m_control {};
+};
+
+struct Simulation
+{
+  std::string name;
+  std::vector<std::string> args;
+  int ticks = 0;
+  uint32_t seed = 0;
+  bool randomInput = false;
+  const Replay* replay = nullptr;
+};
+
+struct Result
+{
+  int ticks = 0;
+  double seconds = 0;
+  double averageTickUs = 0;
+  double p99TickUs = 0;
+  double spritesPerFrame = 0;
+  double linesPerFrame = 0;
+  double rectsPerFrame = 0;
+  double textsPerFrame = 0;
+  int sounds = 0;
+  std::vector<StatVal> stats;
+  std::string error;
+};
+
+Result run(const Simulation& sim)
+{
+  Result r;
+
+  seedRandom(sim.seed);
+
+  NullRenderer renderer;
+  NullAudio audio;
+  std::unique_ptr<Scene> scene(createGame(&renderer, &audio, sim.args));
+
+  std::unique_ptr<ReplayPlayer> player;
+
+  if(sim.replay)
+    player = std::make_unique<ReplayPlayer>(*sim.replay);
+
+  RandomInput randomInput(sim.seed);
+
+  std::vector<double> durations;
+  durations.reserve(sim.ticks);
+
+  auto const start = std::chrono::steady_clock::now();
+
+  for(int i = 0; i < sim.ticks; ++i)
+  {
+    Control c {};
+
+    if(player && !player->next(c))
+      player.reset();
+
+    if(sim.randomInput)
+      c = randomInput.next(i);
+
+    auto const t0 = std::chrono::steady_clock::now();
+    scene->tick(c);
+    auto const t1 = std::chrono::steady_clock::now();
+
+    durations.push_back(std::chrono::duration<double, std::micro>(t1 - t0).count());
+
+    renderer.beginDraw();
+    scene->draw(1.0f);
+    renderer.endDraw();
+  }
+
+  r.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  r.ticks = sim.ticks;
+
+  if(durations.empty())
+    return r;
+
+  double sum = 0;
+
+  for(auto d : durations)
+    sum += d;
+
+  r.averageTickUs = sum / durations.size();
+
+  auto p99 = durations.begin() + (durations.size() * 99) / 100;
+  std::nth_element(durations.begin(), p99, durations.end());
+  r.p99TickUs = *p99;
+
+  r.spritesPerFrame = renderer.sprites / double(renderer.frames);
+  r.linesPerFrame = renderer.lines / double(renderer.frames);
+  r.rectsPerFrame = renderer.rects / double(renderer.frames);
+  r.textsPerFrame = renderer.texts / double(renderer.frames);
+  r.sounds = (int)audio.sounds;
+
+  // gauges are per-thread: collect them before the thread exits
+  for(int i = 0; i < getStatCount(); ++i)
+  {
+    auto stat = getStat(i);
+
+    if(stat.name)
+      r.stats.push_back(stat);
+  }
+
+  return r;
+}
+
+std::vector<Result> runAll(const std::vector<Simulation>& sims, int jobs)
+{
+  std::vector<Result> results(sims.size());
+  std::atomic<int> nextSim(0);
+
+  auto worker = [&] ()
+    {
+      while(1)
+      {
+        const int i = nextSim++;
+
+        if(i >= (int)sims.size())
+          break;
+
+        try
+        {
+          results[i] = run(sims[i]);
+        }
+        catch(Error const& e)
+        {
+          auto msg = e.message();
+          results[i].error.assign(msg.data, msg.len);
+        }
+      }
+    };
+
+  std::vector<std::thread> threads;
+
+  for(int i = 0; i < jobs; ++i)
+    threads.push_back(std::thread(worker));
+
+  for(auto& t : threads)
+    t.join();
+
+  return results;
+}
+
+void printResult(const Result& r)
+{
+  printf("ticks: %d\n", r.ticks);
+  printf("ticks/s: %.0f\n", r.ticks / r.seconds);
+  printf("tick duration: average %.1f us, p99 %.1f us\n", r.averageTickUs, r.p99TickUs);
+  printf("sprites/frame: %.1f\n", r.spritesPerFrame);
+  printf("lines/frame: %.1f\n", r.linesPerFrame);
+  printf("rects/frame: %.1f\n", r.rectsPerFrame);
+  printf("texts/frame: %.1f\n", r.textsPerFrame);
+  printf("sounds played: %d\n", r.sounds);
+
+  for(auto& stat : r.stats)
+    printf("%s: %.2f\n", stat.name, stat.val);
+}
+
+int runMain(int argc, char* argv[])
+{
+  int ticks = 10000;
+  bool ticksGiven = false;
+  int jobs = std::max(1, (int)std::thread::hardware_concurrency());
+  int firstLevel = 0;
+  int lastLevel = -1;
+  int randomRuns = 0;
+  std::string replayPath;
+  std::vector<std::string> args;
+
+  for(int i = 1; i < argc; ++i)
+  {
+    std::string arg = argv[i];
+
+    if(arg == "--ticks" && i + 1 < argc)
+    {
+      ticks = atoi(argv[++i]);
+      ticksGiven = true;
+    }
+    else if(arg == "--replay" && i + 1 < argc)
+      replayPath = argv[++i];
+    else if(arg == "--jobs" && i + 1 < argc)
+      jobs = std::max(1, atoi(argv[++i]));
+    else if(arg == "--runs" && i + 1 < argc)
+      randomRuns = atoi(argv[++i]);
+    else if(arg == "--levels" && i + 1 < argc)
+    {
+      if(sscanf(argv[++i], "%d-%d", &firstLevel, &lastLevel) != 2)
+        throw Error("Invalid level range, expected: A-B");
+    }
+    else
+      args.push_back(arg);
+  }
+
+  Replay replay;
+  Simulation base;
+  base.args = args;
+  base.ticks = ticks;
+
+  if(!replayPath.empty())
+  {
+    auto data = File::read(replayPath);
+    replay = deserializeReplay({ (const uint8_t*)data.data(), (int)data.size() });
+
+    base.replay = &replay;
+    base.seed = replay.seed;
+    base.args.clear();
+
+    if(replay.level >= 0)
+      base.args.push_back(std::to_string(replay.level));
+
+    if(!ticksGiven)
+      base.ticks = replay.tickCount;
+  }
+
+  std::vector<Simulation> sims;
+
+  if(lastLevel >= firstLevel)
+  {
+    for(int level = firstLevel; level <= lastLevel; ++level)
+    {
+      auto sim = base;
+      sim.name = "level " + std::to_string(level);
+      sim.args = { std::to_string(level) };
+      sims.push_back(sim);
+    }
+  }
+  else if(randomRuns > 0)
+  {
+    for(int k = 0; k < randomRuns; ++k)
+    {
+      auto sim = base;
+      sim.name = "run " + std::to_string(k);
+      sim.seed = k + 1;
+      sim.randomInput = true;
+      sims.push_back(sim);
+    }
+  }
+  else
+  {
+    sims.push_back(base);
+  }
+
+  jobs = std::min(jobs, (int)sims.size());
+
+  auto const start = std::chrono::steady_clock::now();
+  auto results = runAll(sims, jobs);
+  auto const totalTime = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+  if(sims.size() == 1)
+  {
+    if(!results[0].error.empty())
+      throw Error(results[0].error);
+
+    printResult(results[0]);
+    return 0;
+  }
+
+  int totalTicks = 0;
+  int failures = 0;
+
+  for(int i = 0; i < (int)sims.size(); ++i)
+  {
+    auto& r = results[i];
+
+    if(!r.error.empty())
+    {
+      printf("%s: FAILED: %s\n", sims[i].name.c_str(), r.error.c_str());
+      ++failures;
+      continue;
+    }
+
+    printf("%s: %.0f ticks/s, average %.1f us, p99 %.1f us\n", sims[i].name.c_str(), r.ticks / r.seconds, r.averageTickUs, r.p99TickUs);
+    totalTicks += r.ticks;
+  }
+
+  printf("%d simulations, %d jobs: %.0f ticks/s overall\n", (int)sims.size(), jobs, totalTicks / totalTime);
+
+  return failures ? 1 : 0;
+}
+}
+
+int main(int argc, char* argv[])
+{
+  try
+  {
+    return runMain(argc, argv);
+  }
+  catch(Error const& e)
+  {
+    const auto msg = e.message();
+    fflush(stdout);
+    logMsg("Fatal: %.*s", msg.len, msg.data);
+    return 1;
+  }
+}
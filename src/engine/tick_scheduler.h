@@ -0,0 +1,91 @@
+// Copyright (C) 2023 - Sebastien Alaiwan
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as
+// published by the Free Software Foundation, either version 3 of the
+// License, or (at your option) any later version.
+
+// Decides how many fixed-rate ticks to run for each display frame.
+// After a stall (slow level load, window drag, browser GC pause, ...),
+// catching up with the wall clock can take hundreds of ticks,
+// which would make the next frames late too ("spiral of death").
+// Instead, each frame runs a bounded number of ticks, and the time
+// that couldn't be caught up with is either carried to the next frames,
+// or dropped (the game then runs slower than real-time).
+
+#pragma once
+
+#include <algorithm>
+
+struct TickScheduler
+{
+  // limits for one display frame
+  int maxTicksPerFrame = 10;
+  int tickBudgetMs = 12; // time spent ticking, 0 means no limit
+
+  // late ticks carried to the next frames. Beyond that, they're dropped.
+  int maxDebtTicks = 10;
+
+  // statistics about the last frame
+  int ticks = 0;
+  int droppedTicks = 0;
+  int deferredTicks = 0;
+
+  void reset(int now)
+  {
+    m_lastTime = now;
+    m_lastRemainder = 0;
+  }
+
+  void beginFrame(int now)
+  {
+    m_now = now;
+    m_frameStart = now;
+    ticks = 0;
+  }
+
+  // returns true if one more tick must be run for this frame.
+  // 'clock' is the current time, to check the tick budget.
+  bool nextTick(int freq, int clock)
+  {
+    const auto nextTime = m_lastTime + (1000 + m_lastRemainder) / freq;
+
+    if(nextTime >= m_now)
+      return false;
+
+    if(ticks >= maxTicksPerFrame)
+      return false;
+
+    if(tickBudgetMs && clock - m_frameStart >= tickBudgetMs)
+      return false;
+
+    m_lastTime = nextTime;
+    m_lastRemainder = (1000 + m_lastRemainder) % freq;
+    ++ticks;
+
+    return true;
+  }
+
+  void endFrame(int freq)
+  {
+    const int late = std::max(0, (m_now - m_lastTime - 1) * freq / 1000);
+
+    deferredTicks = std::min(late, maxDebtTicks);
+    droppedTicks = late - deferredTicks;
+
+    // forget about the time we won't catch up with
+    if(droppedTicks)
+      m_lastTime += droppedTicks * 1000 / freq;
+  }
+
+  // where the current time lies between the last tick and the next one, in [0 .. 1]
+  float alpha(int freq) const
+  {
+    return std::min(1.0f, float(m_now - m_lastTime) * freq / (1000.0f + m_lastRemainder));
+  }
+
+private:
+  int m_now = 0;
+  int m_frameStart = 0;
+  int m_lastTime = 0;
+  int m_lastRemainder = 0;
+};
@@ -103,6 +103,12 @@ struct FragileBlock : Entity, Damageable
     state = 1;
   }
 
+  void serialize(Serializer& s) override
+  {
+    Entity::serialize(s);
+    s.io(state, timer, model, tile);
+  }
+
   int state = 0; // 0: solid, 1:disapearing, 2: disapeared
   int timer = 0;
 
@@ -191,6 +197,12 @@ struct CrumbleBlock : Entity
     }
   }
 
+  void serialize(Serializer& s) override
+  {
+    Entity::serialize(s);
+    s.io(openingTimer, model, tile);
+  }
+
   int openingTimer = 0;
   enum { OPEN_DURATION = 40 };
 
@@ -78,6 +78,12 @@ struct Bonus : Entity
     }
   }
 
+  void serialize(Serializer& s) override
+  {
+    Entity::serialize(s);
+    s.io(time);
+  }
+
   static constexpr uint32_t flags = EntityFlag_ShowOnMinimap_O | EntityFlag_Persist;
 
   int time = 0;
@@ -56,6 +56,12 @@ struct Conveyor : Entity
     sink->sendActor(r);
   }
 
+  void serialize(Serializer& s) override
+  {
+    Entity::serialize(s);
+    s.io(m_time);
+  }
+
   float speed = 0;
   float m_time = 0;
 };
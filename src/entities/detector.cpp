@@ -57,6 +57,12 @@ struct RoomBoundaryDetector : Entity
     touched = true;
   }
 
+  void serialize(Serializer& s) override
+  {
+    Entity::serialize(s);
+    s.io(touched);
+  }
+
   int targetLevel = 0;
   Vector transform;
   bool touched = false;
@@ -69,6 +69,12 @@ struct Door : Entity
     sink->sendActor(r);
   }
 
+  void serialize(Serializer& s) override
+  {
+    Entity::serialize(s);
+    s.io(state, delay);
+  }
+
   bool state = false;
   int delay = 0;
   const int link;
@@ -127,6 +133,12 @@ struct BreakableDoor : Entity, Damageable
       game->playSound(SND_DAMAGE);
   }
 
+  void serialize(Serializer& s) override
+  {
+    Entity::serialize(s);
+    s.io(life);
+  }
+
   int life = 130;
 };
 
@@ -62,6 +62,12 @@ struct ExitPoint : Entity
     }
   }
 
+  void serialize(Serializer& s) override
+  {
+    Entity::serialize(s);
+    s.io(active, timer);
+  }
+
   bool active = true;
   int timer = 0;
 };
@@ -45,6 +45,12 @@ struct Explosion : Entity
     sink->sendActor(r);
   }
 
+  void serialize(Serializer& s) override
+  {
+    Entity::serialize(s);
+    s.io(time);
+  }
+
   int time = 0;
 };
 
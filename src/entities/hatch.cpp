@@ -66,6 +66,12 @@ struct Hatch : Entity
     }
   }
 
+  void serialize(Serializer& s) override
+  {
+    Entity::serialize(s);
+    s.io(openingTimer);
+  }
+
   int openingTimer = 0;
   enum { OPEN_DURATION = 100 };
 };
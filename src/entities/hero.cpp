@@ -76,6 +76,12 @@ struct Bullet : Entity
     dead = true;
   }
 
+  void serialize(Serializer& s) override
+  {
+    Entity::serialize(s);
+    s.io(life, vel);
+  }
+
   int life = 1000;
   Vector vel;
 };
@@ -87,6 +93,7 @@ struct Bomb : Entity
     size = Size(0.4, 0.4);
 
     collidesWith = CG_WALLS | CG_ENEMIES;
+    Body::onCollision = [this] (Body* other) { onCollide(other); };
   }
 
   void addActors(IActorSink* sink) const override
@@ -110,8 +117,6 @@ struct Bomb : Entity
       const auto center = getCenter();
       size = UnitSize * 1.5;
       pos = center - size * 0.5;
-
-      Body::onCollision = [this] (Body* other) { onCollide(other); };
     }
 
     if(life == 0)
@@ -123,10 +128,20 @@ struct Bomb : Entity
 
   void onCollide(Body* other)
   {
+    // only hurts once exploded
+    if(life > 0)
+      return;
+
     if(auto damageable = dynamic_cast<Damageable*>(other))
       damageable->onDamage(10);
   }
 
+  void serialize(Serializer& s) override
+  {
+    Entity::serialize(s);
+    s.io(life, exploding);
+  }
+
   int life = 70;
   int exploding = 2;
 };
@@ -642,6 +657,14 @@ struct Rockman : Entity, Damageable, Playerable
     }
   }
 
+  void serialize(Serializer& s) override
+  {
+    Entity::serialize(s);
+    s.io(debounceFire, dir, ground, jumpbutton, firebutton, dashbutton, restartbutton);
+    s.io(time, climbDelay, hurtDelay, dashDelay, dieDelay, shootDelay, ladderDelay, swimDelay);
+    s.io(ladderX, life, doubleJumped, ball, sliding, ladder, control, vel, upgrades);
+  }
+
   int debounceFire = 0;
   ORIENTATION dir = RIGHT;
   bool ground = false;
@@ -654,7 +677,7 @@ struct Rockman : Entity, Damageable, Playerable
   int shootDelay = 0;
   int ladderDelay = 0;
   int swimDelay = 0;
-  float ladderX;
+  float ladderX = 0;
   int life = MAX_LIFE;
   bool doubleJumped = false;
   bool ball = false;
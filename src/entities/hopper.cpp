@@ -6,6 +6,7 @@
 
 #include "base/scene.h"
 #include "base/util.h"
+#include "misc/math.h" // randomInt
 
 #include "gameplay/collision_groups.h"
 #include "gameplay/entity.h"
@@ -17,8 +18,6 @@
 
 #include "explosion.h"
 
-#include <cstdlib> // rand
-
 namespace
 {
 struct Hopper : Entity, Damageable
@@ -57,7 +56,7 @@ struct Hopper : Entity, Damageable
 
     vel.y -= 0.005; // gravity
 
-    if(ground && time % 50 == 0 && rand() % 4 == 0)
+    if(ground && time % 50 == 0 && randomInt() % 4 == 0)
     {
       vel.y = 0.13;
       ground = false;
@@ -106,6 +105,12 @@ struct Hopper : Entity, Damageable
     }
   }
 
+  void serialize(Serializer& s) override
+  {
+    Entity::serialize(s);
+    s.io(life, time, ground, dir, vel);
+  }
+
   int life = 30;
   int time = 0;
   bool ground = false;
@@ -151,6 +151,12 @@ struct Lift : Entity
     }
   }
 
+  void serialize(Serializer& s) override
+  {
+    Entity::serialize(s);
+    s.io(state, timer, debounceTrigger);
+  }
+
   int state = 0;
   int timer = 0;
   int debounceTrigger = 0;
@@ -74,6 +74,12 @@ struct SavePoint : Entity
     }
   }
 
+  void serialize(Serializer& s) override
+  {
+    Entity::serialize(s);
+    s.io(timer, m_time);
+  }
+
   static constexpr uint32_t flags = EntityFlag_ShowOnMinimap_S;
 
   int timer = 0;
@@ -103,6 +103,12 @@ struct Shutter : Entity
     sink->sendActor(r);
   }
 
+  void serialize(Serializer& s) override
+  {
+    Entity::serialize(s);
+    s.io(state, delay);
+  }
+
   bool state = false;
   int delay = 0;
   const int link;
@@ -55,6 +55,12 @@ struct SpiderBullet : Entity
     dead = true;
   }
 
+  void serialize(Serializer& s) override
+  {
+    Entity::serialize(s);
+    s.io(life, vel);
+  }
+
   int life = 100;
   Vector vel;
 };
@@ -146,6 +152,12 @@ struct Spider : Entity, Damageable
     }
   }
 
+  void serialize(Serializer& s) override
+  {
+    Entity::serialize(s);
+    s.io(life, time, dir);
+  }
+
   int life = 60;
   int time = 0;
   float dir;
@@ -88,6 +88,12 @@ struct Sweeper : Entity, Damageable
     }
   }
 
+  void serialize(Serializer& s) override
+  {
+    Entity::serialize(s);
+    s.io(life, time, vel);
+  }
+
   int life = 30;
   int time = 0;
   Vector vel;
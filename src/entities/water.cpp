@@ -43,6 +43,12 @@ struct Water : Entity, Swimmable
     sink->sendActor(r);
   }
 
+  void serialize(Serializer& s) override
+  {
+    Entity::serialize(s);
+    s.io(m_time);
+  }
+
   float m_time = 0;
 };
 
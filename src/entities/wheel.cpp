@@ -92,6 +92,12 @@ struct Wheel : Entity, Damageable
     }
   }
 
+  void serialize(Serializer& s) override
+  {
+    Entity::serialize(s);
+    s.io(life, time, dir, vel);
+  }
+
   int life = 30;
   int time = 0;
   float dir;
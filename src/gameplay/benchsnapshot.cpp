@@ -0,0 +1,97 @@
+// Copyright (C) 2025 - Sebastien Alaiwan
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as
+// published by the Free Software Foundation, either version 3 of the
+// License, or (at your option) any later version.
+
+// Benchmark: cost of a save/restore cycle (see snapshot.h) on each room.
+//
+// Usage: benchsnapshot.exe [cycles] (default: 100)
+// Must be run from the directory containing 'res/'.
+
+#include <algorithm> // max
+#include <chrono>
+#include <cstdio>
+#include <cstdlib> // atoi
+#include <memory>
+#include <vector>
+
+#include "base/error.h"
+#include "base/logger.h"
+#include "base/scene.h"
+#include "load_quest.h"
+#include "presenter.h"
+#include "snapshot.h"
+#include "state_machine.h"
+
+namespace
+{
+struct NullPresenter : IPresenter
+{
+  void sendActor(SpriteActor const &) override {}
+  void sendActor(TileActor const &) override {}
+  void sendActor(DebugRectActor const &) override {}
+  void preload(Resource) override {}
+  void textBox(String) override {}
+  void playMusic(MUSIC) override {}
+  void stopMusic() override {}
+  void playSound(SOUND) override {}
+  void setCameraPos(Vec2f) override {}
+  void setAmbientLight(float) override {}
+  void loadTileLayer(MODEL, int, const Matrix2<int>&) override {}
+  void drawTileLayer() override {}
+  void flushFrame() override {}
+};
+
+void bench(int level, int cycles)
+{
+  NullPresenter presenter;
+  std::unique_ptr<Scene> scene(createPlayingStateAtLevel(&presenter, level));
+  auto snapshotable = dynamic_cast<Snapshotable*>(scene.get());
+
+  if(!snapshotable)
+    throw Error("The playing state can't be snapshotted");
+
+  Control noInput {};
+
+  for(int i = 0; i < 10; ++i)
+    scene->tick(noInput);
+
+  std::vector<uint8_t> state;
+
+  auto const t0 = std::chrono::steady_clock::now();
+
+  for(int i = 0; i < cycles; ++i)
+  {
+    state.clear();
+    snapshotable->saveState(state);
+    snapshotable->loadState(state);
+  }
+
+  auto const t1 = std::chrono::steady_clock::now();
+  auto const us = std::chrono::duration<double, std::micro>(t1 - t0).count();
+
+  printf("room %d: %d bytes, save+restore: %.1f us\n", level, (int)state.size(), us / cycles);
+}
+}
+
+int main(int argc, char* argv[])
+{
+  try
+  {
+    const int cycles = argc > 1 ? std::max(1, atoi(argv[1])) : 100;
+    const int roomCount = (int)loadQuest("res/quest.gz").rooms.size();
+
+    for(int level = 0; level < roomCount; ++level)
+      bench(level, cycles);
+
+    return 0;
+  }
+  catch(Error const& e)
+  {
+    const auto msg = e.message();
+    fflush(stdout);
+    logMsg("Fatal: %.*s", msg.len, msg.data);
+    return 1;
+  }
+}
@@ -13,6 +13,8 @@
 #include "base/matrix.h"
 #include "vec.h"
 
+struct Serializer;
+
 struct Shape
 {
   virtual ~Shape() = default;
@@ -46,6 +48,9 @@ struct Body
   Delegate<void(Body*)> onCollision = [] (Body*) {};
 
   Box getBox() const { return Box { pos, size }; }
+
+  // reads/writes the dynamic state of the body (see snapshot.h)
+  virtual void serialize(Serializer& s);
 };
 
 struct ShapeBox : Shape
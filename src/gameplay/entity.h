@@ -16,6 +16,7 @@
 #include "game.h"
 #include "physics_probe.h"
 #include "presenter.h" // IActorSink
+#include "snapshot.h"
 #include <stdint.h>
 #include <vector>
 
@@ -53,11 +54,19 @@ struct Entity : Body
 
   virtual void addActors(IActorSink* sink) const = 0;
 
+  // derived classes must call their parent's 'serialize'
+  void serialize(Serializer& s) override
+  {
+    Body::serialize(s);
+    s.io(id, dead, blinking);
+  }
+
   static constexpr uint32_t flags = 0;
 
   int id = 0;
   bool dead = false;
   int blinking = 0;
+  Vector prevPos {}; // position at the previous tick, for display interpolation
   IGame* game = nullptr;
   IPhysicsProbe* physics = nullptr;
 
@@ -59,9 +59,9 @@ struct RootScene : Scene
     return nullptr;
   }
 
-  void draw() override
+  void draw(float alpha) override
   {
-    m_scene->draw();
+    m_scene->draw(alpha);
     m_presenter->flushFrame();
   }
 
@@ -14,6 +14,7 @@
 #include "misc/math.h"
 #include "misc/stats.h"
 #include "physics.h"
+#include "snapshot.h"
 #include "spatial_hashing.h"
 #include <vector>
 
@@ -24,11 +25,19 @@ Body::Body()
 {
 }
 
+void Body::serialize(Serializer& s)
+{
+  s.io(solid, pusher, crushed, pos, size, collisionGroup, collidesWith);
+
+  // will be recomputed by the next move
+  if(s.reading())
+    floor = nullptr;
+}
+
 namespace
 {
 Gauge ggOverlapChecks("physics.overlap_tests");
 Gauge ggRaycasts("physics.raycasts");
-int raycastCount = 0;
 
 struct Physics : IPhysics
 {
@@ -145,9 +154,9 @@ struct Physics : IPhysics
     }
 
     ggOverlapChecks = checkCount;
-    ggRaycasts = raycastCount;
+    ggRaycasts = m_raycastCount;
 
-    raycastCount = 0;
+    m_raycastCount = 0;
   }
 
   void collideBodies(Body& me, Body& other)
@@ -189,7 +198,7 @@ struct Physics : IPhysics
       if(!(body->collisionGroup & collisionGroup))
         continue;
 
-      raycastCount++;
+      m_raycastCount++;
       Box transformedBox = box;
       Vector transformedDelta = delta;
       const Vector scale = { 1.0f / body->size.x, 1.0f / body->size.y };
@@ -258,6 +267,7 @@ private:
 
   std::vector<Body*> m_bodies;
   HashedSpace m_hashedSpace;
+  mutable int m_raycastCount = 0;
 };
 
 Vec2f rotateLeft(Vec2f v) { return Vec2f(-v.y, v.x); }
@@ -7,6 +7,7 @@
 #include "presenter.h"
 
 #include <string>
+#include <vector>
 
 namespace
 {
@@ -100,9 +101,9 @@ struct GamePresenter : IPresenter
     m_audio->releaseVoice(voiceId, true);
   }
 
-  void setCameraPos(Vec2f pos, bool teleport) override
+  void setCameraPos(Vec2f pos) override
   {
-    m_renderer->setCamera(pos, teleport);
+    m_renderer->setCamera(pos);
   }
 
   void setAmbientLight(float amount) override
@@ -110,6 +111,26 @@ struct GamePresenter : IPresenter
     m_renderer->setAmbientLight(amount);
   }
 
+  void loadTileLayer(MODEL model, int zOrder, const Matrix2<int>& tiles) override
+  {
+    std::vector<int> actions;
+    actions.reserve(tiles.size.x * tiles.size.y);
+
+    tiles.scan([&] (int, int, int tile) { actions.push_back(tile); });
+
+    RenderTileLayer layer {};
+    layer.modelId = (int)model;
+    layer.zOrder = zOrder;
+    layer.size = tiles.size;
+    layer.tiles = actions;
+    m_renderer->loadTileLayer(layer);
+  }
+
+  void drawTileLayer() override
+  {
+    m_renderer->drawTileLayer();
+  }
+
   void sendActor(SpriteActor const& actor) override
   {
     RenderSprite s;
@@ -158,26 +179,14 @@ struct GamePresenter : IPresenter
 
   void sendActor(DebugRectActor const& actor) override
   {
-    Vec2f pos[4][2] =
-    {
-      { Vec2f(actor.pos[0].x, actor.pos[0].y), { Vec2f(actor.pos[0].x, actor.pos[1].y) } },
-      { Vec2f(actor.pos[0].x, actor.pos[1].y), { Vec2f(actor.pos[1].x, actor.pos[1].y) } },
-      { Vec2f(actor.pos[1].x, actor.pos[1].y), { Vec2f(actor.pos[1].x, actor.pos[0].y) } },
-      { Vec2f(actor.pos[1].x, actor.pos[0].y), { Vec2f(actor.pos[0].x, actor.pos[0].y) } },
-    };
-
-    for(auto& line : pos)
-    {
-      RenderLine s {};
-      s.useWorldRefFrame = true;
-      s.a = line[0];
-      s.b = line[1];
-      s.color = { 8, 8, 0, 1 };
-      s.thicknessMin = 0.5;
-      s.thicknessMax = 0.1;
-      s.zOrder = 100;
-      m_renderer->drawLine(s);
-    }
+    RenderRect r {};
+    r.useWorldRefFrame = true;
+    r.pos[0] = actor.pos[0];
+    r.pos[1] = actor.pos[1];
+    r.color = { 8, 8, 0, 1 };
+    r.thickness = 0.1;
+    r.zOrder = 100;
+    m_renderer->drawRect(r);
   }
 
 private:
@@ -10,6 +10,7 @@
 
 #include "base/box.h"
 #include "base/geom.h"
+#include "base/matrix.h"
 #include "base/resource.h"
 
 typedef int SOUND;
@@ -72,9 +73,14 @@ struct IPresenter : IActorSink
   virtual void playMusic(MUSIC id) = 0;
   virtual void stopMusic() = 0;
   virtual void playSound(SOUND id) = 0;
-  virtual void setCameraPos(Vec2f pos, bool teleport = false) = 0;
+  virtual void setCameraPos(Vec2f pos) = 0;
   virtual void setAmbientLight(float amount) = 0;
 
+  // the tiles of the room, which never change while in the room.
+  // Uploaded once: 'drawTileLayer' then draws them in the current frame.
+  virtual void loadTileLayer(MODEL model, int zOrder, const Matrix2<int>& tiles) = 0;
+  virtual void drawTileLayer() = 0;
+
   virtual void flushFrame() = 0;
 };
 
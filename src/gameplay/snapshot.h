@@ -0,0 +1,102 @@
+// Copyright (C) 2023 - Sebastien Alaiwan
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as
+// published by the Free Software Foundation, either version 3 of the
+// License, or (at your option) any later version.
+
+// In-memory snapshots of the game state.
+// Everything is written into a single flat byte buffer, which the caller
+// can keep around and reuse: taking a snapshot doesn't allocate per object.
+
+#pragma once
+
+#include <cstdint>
+#include <cstring> // memcpy
+#include <type_traits>
+#include <vector>
+
+#include "base/error.h"
+#include "base/span.h"
+
+// Reads or writes plain values, depending on how it was constructed.
+// The same 'serialize' function is used for both directions.
+struct Serializer
+{
+  // writing: values get appended to 'buffer'
+  Serializer(std::vector<uint8_t>& buffer) : m_out(&buffer)
+  {
+  }
+
+  // reading: values are consumed from 'buffer'
+  Serializer(Span<const uint8_t> buffer) : m_in(buffer)
+  {
+  }
+
+  bool reading() const { return !m_out; }
+
+  template<typename T>
+  void io(T& value)
+  {
+    static_assert(std::is_trivially_copyable<T>::value, "only plain values can be serialized");
+    raw(&value, sizeof value);
+  }
+
+  template<typename T, typename ... Rest>
+  void io(T& value, Rest& ... rest)
+  {
+    io(value);
+    io(rest ...);
+  }
+
+  void raw(void* data, int size)
+  {
+    if(m_out)
+    {
+      auto p = (const uint8_t*)data;
+      m_out->insert(m_out->end(), p, p + size);
+    }
+    else
+    {
+      if(m_pos + size > m_in.len)
+        throw Error("Truncated snapshot");
+
+      memcpy(data, m_in.data + m_pos, size);
+      m_pos += size;
+    }
+  }
+
+  // number of bytes written or consumed so far
+  int tell() const { return m_out ? (int)m_out->size() : m_pos; }
+
+  void skip(int size)
+  {
+    if(m_pos + size > m_in.len)
+      throw Error("Truncated snapshot");
+
+    m_pos += size;
+  }
+
+  // overwrite an already written value (e.g a size prefix)
+  template<typename T>
+  void patch(int offset, T value)
+  {
+    memcpy(m_out->data() + offset, &value, sizeof value);
+  }
+
+private:
+  std::vector<uint8_t>* m_out = nullptr;
+  Span<const uint8_t> m_in;
+  int m_pos = 0;
+};
+
+// Implemented by game states whose live state can be captured.
+struct Snapshotable
+{
+  virtual ~Snapshotable() = default;
+
+  // appends the current state to 'dst'
+  virtual void saveState(std::vector<uint8_t>& dst) = 0;
+
+  // brings the game back to a state previously saved with 'saveState'
+  virtual void loadState(Span<const uint8_t> src) = 0;
+};
@@ -51,6 +51,12 @@ void HashedSpace::removeObject(Rect2f where, uintptr_t what)
   }
 }
 
+void HashedSpace::clear()
+{
+  for(auto& cell : m_cells)
+    cell.objects.clear();
+}
+
 std::vector<uintptr_t> HashedSpace::getObjectsInRect(Rect2f where) const
 {
   std::vector<uintptr_t> result;
@@ -12,6 +12,9 @@ public:
   void putObject(Rect2f where, uintptr_t what);
   void removeObject(Rect2f where, uintptr_t what);
 
+  // removes all objects, but keeps the allocated cells
+  void clear();
+
   std::vector<uintptr_t> getObjectsInRect(Rect2f where) const;
 
 private:
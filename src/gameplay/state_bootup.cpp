@@ -49,7 +49,7 @@ struct BootupState : Scene
     return this;
   }
 
-  void draw() override
+  void draw(float) override
   {
     float ratio = std::min(timer / float(BEEPTIME), 1.0f);
     auto splash = SpriteActor { NullVector, MDL_BOOTUP };
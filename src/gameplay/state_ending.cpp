@@ -57,7 +57,7 @@ struct EndingState : Scene
     return this;
   }
 
-  void draw() override
+  void draw(float) override
   {
     auto splash = SpriteActor { NullVector, MDL_ENDING };
     splash.scale = { 15, 10 };
@@ -69,7 +69,7 @@ struct PausedState : Scene
     return this;
   }
 
-  void draw() override
+  void draw(float) override
   {
     drawMinimap(view, m_scrollf, mapViewModel);
 
@@ -6,9 +6,12 @@
 
 // Game logic
 
+#include <algorithm> // sort
 #include <cmath>
 #include <cstring> // strlen
 #include <map>
+#include <mutex>
+#include <typeinfo>
 
 #include "base/error.h"
 #include "base/logger.h"
@@ -27,6 +30,8 @@
 #include "player.h"
 #include "presenter.h"
 #include "quest.h"
+#include "snapshot.h"
+#include "spatial_hashing.h"
 #include "state_machine.h"
 #include "toggle.h"
 #include "variable.h"
@@ -35,6 +40,17 @@ extern const Vec2i CELL_SIZE;
 
 namespace
 {
+const uint32_t SnapshotMagic = 0x50414E53; // 'SNAP'
+
+Gauge ggEntities("gameplay.entities");
+Gauge ggCulled("gameplay.culled before submission");
+
+// half of the visible area, in world units, around the camera
+const Vec2f HalfScreenSize = { 7.5, 5 };
+
+// sprites can extend beyond the box of their entity
+const Vec2f VisibilityMargin = { 3, 3 };
+
 DebugRectActor getDebugActor(Entity* entity)
 {
   auto box = entity->getBox();
@@ -100,14 +116,71 @@ Vec2i computeQuestMapSize(const Quest& quest)
   return r;
 }
 
-struct InGameScene : Scene, private IGame
+// The quest is never modified: all the live games share the same copy
+// (e.g the parallel simulations of the headless runner).
+std::shared_ptr<const Quest> getSharedQuest()
+{
+  static std::mutex mutex;
+  static std::weak_ptr<const Quest> cache;
+
+  std::lock_guard<std::mutex> lock(mutex);
+
+  auto r = cache.lock();
+
+  if(!r)
+  {
+    r = std::make_shared<const Quest>(loadQuest("res/quest.gz"));
+    cache = r;
+  }
+
+  return r;
+}
+
+// Moves the actors of one entity to its display position
+// (interpolated between the two last ticks).
+struct InterpolatingSink : IActorSink
+{
+  InterpolatingSink(IActorSink* sink) : m_sink(sink) {}
+
+  void sendActor(SpriteActor const& actor) override
+  {
+    auto a = actor;
+
+    if(!a.screenRefFrame)
+      a.pos += offset;
+
+    m_sink->sendActor(a);
+  }
+
+  void sendActor(TileActor const& actor) override
+  {
+    auto a = actor;
+
+    if(!a.screenRefFrame)
+      a.rect.pos += offset;
+
+    m_sink->sendActor(a);
+  }
+
+  void sendActor(DebugRectActor const& actor) override
+  {
+    m_sink->sendActor(actor);
+  }
+
+  Vec2f offset {};
+
+private:
+  IActorSink* const m_sink;
+};
+
+struct InGameScene : Scene, Snapshotable, private IGame
 {
   InGameScene(IPresenter* view) :
-    m_quest(loadQuest("res/quest.gz"))
+    m_questData(getSharedQuest())
+    , m_quest(*m_questData)
     , m_view(view)
   {
     m_shouldLoadLevel = true;
-    m_shouldLoadVars = true;
     m_savedGame.exploredCells.resize(computeQuestMapSize(m_quest));
   }
 
@@ -124,6 +197,12 @@ struct InGameScene : Scene, private IGame
   {
     loadLevelIfNeeded();
 
+    // remember where everything was, for display interpolation
+    for(auto& entity : m_entities)
+      entity->prevPos = entity->pos;
+
+    m_prevCameraPos = m_cameraPos;
+
     // update explored map cells
     if(m_player)
     {
@@ -147,6 +226,8 @@ struct InGameScene : Scene, private IGame
     m_player->think(c);
 
     updateEntities();
+    ggEntities = (int)m_entities.size();
+    m_visibilityIndexDirty = true;
 
     processEvents();
     updateCamera(false);
@@ -162,16 +243,28 @@ struct InGameScene : Scene, private IGame
     return this;
   }
 
-  void draw() override
+  void draw(float alpha) override
   {
     if(!m_player)
       return;
 
-    sendActorsForTileMap();
+    const auto cameraPos = lerp(m_prevCameraPos, m_cameraPos, alpha);
+    m_view->setCameraPos(cameraPos);
 
-    for(auto& entity : m_entities)
+    m_view->drawTileLayer();
+
+    InterpolatingSink sink(m_view);
+
+    // only off-screen entities are skipped: they never build any actor
+    const Vec2f halfVisible = HalfScreenSize + VisibilityMargin;
+    const auto visible = getVisibleEntities(Rect2f(cameraPos - halfVisible, halfVisible * 2));
+    ggCulled = int(m_entities.size() - visible.size());
+
+    for(auto i : visible)
     {
-      entity->addActors(m_view);
+      auto& entity = m_entities[i];
+      sink.offset = lerp(entity->prevPos, entity->pos, alpha) - entity->pos;
+      entity->addActors(&sink);
 
       if(m_debug)
         m_view->sendActor(getDebugActor(entity.get()));
@@ -189,10 +282,10 @@ struct InGameScene : Scene, private IGame
         Vec2f ratio {};
 
         if(m_cameraArea.size.x > 0)
-          ratio.x = (m_cameraPos.x - m_cameraArea.pos.x) / m_cameraArea.size.x;
+          ratio.x = (cameraPos.x - m_cameraArea.pos.x) / m_cameraArea.size.x;
 
         if(m_cameraArea.size.y > 0)
-          ratio.y = (m_cameraPos.y - m_cameraArea.pos.y) / m_cameraArea.size.y;
+          ratio.y = (cameraPos.y - m_cameraArea.pos.y) / m_cameraArea.size.y;
 
         const float rangeX = background.scale.x - screenSize.x;
         const float rangeY = background.scale.y - screenSize.y;
@@ -216,11 +309,205 @@ struct InGameScene : Scene, private IGame
     }
   }
 
+  ////////////////////////////////////////////////////////////////
+  // Snapshotable
+
+  void saveState(std::vector<uint8_t>& dst) override
+  {
+    Serializer s(dst);
+
+    auto magic = SnapshotMagic;
+    s.io(magic, m_level, m_shouldLoadLevel, m_transform, m_gameFinished, startButton);
+
+    int varCount = (int)m_vars.size();
+    s.io(varCount);
+
+    for(auto& var : m_vars)
+    {
+      int name = var.first;
+      int value = var.second->get();
+      s.io(name, value);
+    }
+
+    // each entity is prefixed by its type, its id, and the size of its data.
+    int entityCount = (int)m_entities.size();
+    s.io(entityCount);
+
+    for(auto& entity : m_entities)
+    {
+      uint64_t type = typeid(*entity).hash_code();
+      int size = 0;
+      s.io(type, entity->id, size);
+
+      const int start = s.tell();
+      entity->serialize(s);
+      s.patch(start - (int)sizeof(size), s.tell() - start);
+    }
+  }
+
+  void loadState(Span<const uint8_t> src) override
+  {
+    restoreState(src, false, false);
+    updateCamera(true);
+  }
+
+  // If the live entities are the ones from the snapshot, their state is
+  // overwritten in place. Otherwise, the room is rebuilt from its spawners,
+  // and the entities are matched by id: transient entities (e.g bullets) are lost.
+  void restoreState(Span<const uint8_t> src, bool forceReload, bool keepPlayer)
+  {
+    Serializer s(src);
+
+    uint32_t magic = 0;
+    int level = 0;
+    s.io(magic, level);
+
+    if(magic != SnapshotMagic)
+      throw Error("Invalid snapshot");
+
+    s.io(m_shouldLoadLevel, m_transform, m_gameFinished, startButton);
+
+    const int varsOffset = s.tell();
+    int varCount = 0;
+    s.io(varCount);
+    s.skip(varCount * 2 * sizeof(int));
+
+    const int entitiesOffset = s.tell();
+    int entityCount = 0;
+    s.io(entityCount);
+
+    bool inPlace = !forceReload && m_physics && level == m_level && entityCount == (int)m_entities.size();
+
+    for(int i = 0; inPlace && i < entityCount; ++i)
+    {
+      uint64_t type;
+      int id, size;
+      s.io(type, id, size);
+      s.skip(size);
+
+      auto& entity = *m_entities[i];
+      inPlace = type == typeid(entity).hash_code() && id == entity.id;
+    }
+
+    Serializer vars({ src.data + varsOffset, src.len - varsOffset });
+    vars.io(varCount);
+
+    if(inPlace)
+    {
+      for(auto& var : m_vars)
+        var.second->restore(0);
+
+      for(int i = 0; i < varCount; ++i)
+      {
+        int name, value;
+        vars.io(name, value);
+        getVariableImpl(name)->restore(value);
+      }
+    }
+    else
+    {
+      destroyArena();
+
+      m_vars.clear();
+
+      for(int i = 0; i < varCount; ++i)
+      {
+        int name, value;
+        vars.io(name, value);
+        getVariableImpl(name)->restore(value);
+      }
+
+      createArena(level);
+      removeDeadThings();
+
+      // entities not found in the snapshot were already dead at the time
+      for(auto& entity : m_entities)
+      {
+        if(entity->id)
+          entity->dead = true;
+      }
+    }
+
+    m_level = level;
+
+    Entity* playerEntity = nullptr;
+
+    for(auto& entity : m_entities)
+    {
+      if(dynamic_cast<Playerable*>(entity.get()))
+        playerEntity = entity.get();
+    }
+
+    Serializer entities({ src.data + entitiesOffset, src.len - entitiesOffset });
+    entities.io(entityCount);
+
+    for(int i = 0; i < entityCount; ++i)
+    {
+      uint64_t type;
+      int id, size;
+      entities.io(type, id, size);
+
+      const Span<const uint8_t> data(src.data + entitiesOffset + entities.tell(), size);
+      entities.skip(size);
+
+      Entity* target = nullptr;
+
+      if(inPlace)
+        target = m_entities[i].get();
+      else if(id)
+        target = findEntity(id, type);
+      else if(!keepPlayer && playerEntity && type == typeid(*playerEntity).hash_code())
+        target = playerEntity;
+
+      if(!target)
+        continue;
+
+      m_physics->removeBody(target);
+
+      Serializer in(data);
+      target->serialize(in);
+
+      if(in.tell() != size)
+        throw Error("Corrupted snapshot");
+
+      m_physics->addBody(target);
+    }
+
+    removeDeadThings();
+    m_eventQueue.clear();
+
+    for(auto& entity : m_entities)
+      entity->prevPos = entity->pos;
+
+    m_visibilityIndexDirty = true;
+  }
+
+  Entity* findEntity(int id, uint64_t type)
+  {
+    for(auto& entity : m_entities)
+    {
+      if(entity->id == id && typeid(*entity).hash_code() == type)
+        return entity.get();
+    }
+
+    return nullptr;
+  }
+
   ////////////////////////////////////////////////////////////////
   // internals
 
   void loadLevelIfNeeded()
   {
+    if(m_shouldRespawn)
+    {
+      // bring the room back to the state it had when the game was saved
+      restoreState(m_savedGame.snapshot, true, true);
+      m_player->setPosition(m_savedGame.position);
+      m_shouldRespawn = false;
+      setAmbientLight(0);
+      updateCamera(true);
+    }
+
     if(m_shouldLoadLevel)
     {
       loadLevel(m_level);
@@ -296,30 +583,22 @@ struct InGameScene : Scene, private IGame
     return cameraPos;
   }
 
+  // the camera is sent to the view when drawing (see 'draw')
   void updateCamera(bool teleport)
   {
-    m_cameraPos = computeTargetCameraPos();
-    m_view->setCameraPos(m_cameraPos, teleport);
-  }
-
-  void sendActorsForTileMap() const
-  {
-    auto const model = MDL_TILES_00 + m_currRoomTheme % 8;
-
-    auto onCell =
-      [&] (int x, int y, int tile)
-      {
-        if(tile == -1)
-          return;
-
-        Vec2f pos = Vec2f(x, y);
-        auto actor = TileActor { { pos, UnitSize }, model };
-        actor.action = tile;
-        actor.zOrder = 3;
-        m_view->sendActor(actor);
-      };
+    const auto target = computeTargetCameraPos();
+    const auto delta = target - m_cameraPos;
 
-    m_tilesForDisplay->scan(onCell);
+    // avoid big camera jumps
+    if(teleport || std::abs(delta.x) > 2 || std::abs(delta.y) > 2)
+    {
+      m_cameraPos = target;
+      m_prevCameraPos = target;
+    }
+    else
+    {
+      m_cameraPos = lerp(m_cameraPos, target, 0.3f);
+    }
   }
 
   void removeDeadThings()
@@ -343,12 +622,42 @@ struct InGameScene : Scene, private IGame
       spawned->game = this;
       spawned->physics = m_physics.get();
       spawned->enter();
+      spawned->prevPos = spawned->pos;
 
       m_physics->addBody(spawned.get());
       m_entities.push_back(std::move(spawned));
     }
   }
 
+  // indices (into 'm_entities') of the entities overlapping 'rect',
+  // in submission order.
+  // The index is rebuilt at most once per tick, as entities move freely.
+  std::vector<uintptr_t> getVisibleEntities(Rect2f rect)
+  {
+    if(m_visibilityIndexDirty)
+    {
+      m_visibilityIndex.clear();
+
+      for(int i = 0; i < (int)m_entities.size(); ++i)
+      {
+        auto& entity = *m_entities[i];
+
+        // cover the whole interpolation path
+        const Vec2f minPos = { std::min(entity.pos.x, entity.prevPos.x), std::min(entity.pos.y, entity.prevPos.y) };
+        const Vec2f maxPos = { std::max(entity.pos.x, entity.prevPos.x), std::max(entity.pos.y, entity.prevPos.y) };
+        m_visibilityIndex.putObject(Rect2f(minPos, maxPos - minPos + entity.size), i);
+      }
+
+      m_visibilityIndexDirty = false;
+    }
+
+    auto r = m_visibilityIndex.getObjectsInRect(rect);
+
+    // keep the order stable for sprites at the same depth
+    std::sort(r.begin(), r.end());
+    return r;
+  }
+
   static bool isDead(std::unique_ptr<Entity> const& e)
   {
     return e->dead;
@@ -356,9 +665,12 @@ struct InGameScene : Scene, private IGame
 
   void loadLevel(int levelIdx)
   {
-    ///////////////////////////////////////////////////////////////////////////
-    // destroy current game arena
-    ///////////////////////////////////////////////////////////////////////////
+    destroyArena();
+    createArena(levelIdx);
+  }
+
+  void destroyArena()
+  {
     if(m_player)
       m_player->leaveLevel();
 
@@ -366,21 +678,10 @@ struct InGameScene : Scene, private IGame
 
     m_entities.clear();
     m_spawned.clear();
+  }
 
-    if(m_shouldLoadVars)
-    {
-      m_vars.clear();
-
-      for(auto& savedVar : m_savedGame.varValues)
-        getVariable(savedVar.first)->set(savedVar.second);
-
-      m_shouldLoadVars = false;
-    }
-
-    ///////////////////////////////////////////////////////////////////////////
-    // create new game arena
-    ///////////////////////////////////////////////////////////////////////////
-
+  void createArena(int levelIdx)
+  {
     m_physics.reset(createPhysics());
 
     if(levelIdx < 0 || levelIdx >= (int)m_quest.rooms.size())
@@ -400,9 +701,8 @@ struct InGameScene : Scene, private IGame
     spawnEntities(level, this);
     removeDeadThings();
 
-    m_tilesForDisplay = &level.tilesForDisplay;
     m_currRoomSize = level.size;
-    m_currRoomTheme = level.theme;
+    m_view->loadTileLayer(MDL_TILES_00 + level.theme % 8, 3, level.tilesForDisplay);
     m_view->playMusic(level.theme);
 
     // load new background
@@ -472,6 +772,11 @@ struct InGameScene : Scene, private IGame
   }
 
   IVariable* getVariable(int name) override
+  {
+    return getVariableImpl(name);
+  }
+
+  Variable* getVariableImpl(int name)
   {
     if(!m_vars[name])
       m_vars[name] = std::make_unique<Variable>();
@@ -491,30 +796,23 @@ struct InGameScene : Scene, private IGame
 
   struct SavedGame
   {
-    int level = 0;
     Vector position = NullVector;
-    std::map<int, int> varValues;
+    std::vector<uint8_t> snapshot; // room state, see 'saveState'
     Matrix2<int> exploredCells; // 0 unknown, 1 known, 2 explored
   };
 
   void onSaveEvent()
   {
-    m_savedGame.level = m_level;
     m_savedGame.position = m_player->position();
     m_savedGame.position.y = round(m_savedGame.position.y) + 0.02;
-    m_savedGame.varValues.clear();
-
-    for(auto& var : m_vars)
-      m_savedGame.varValues[var.first] = var.second->get();
+    m_savedGame.snapshot.clear();
+    saveState(m_savedGame.snapshot);
   }
 
   void respawn() override
   {
     logMsg("Respawning!");
-    m_level = m_savedGame.level;
-    m_transform = m_savedGame.position - m_player->position();
-    m_shouldLoadLevel = true;
-    m_shouldLoadVars = true;
+    m_shouldRespawn = true;
   }
 
   void textBox(char const* msg) override
@@ -531,19 +829,19 @@ struct InGameScene : Scene, private IGame
   }
 
   int m_level = 1;
-  int m_currRoomTheme = 0;
 
   bool m_shouldLoadLevel = false;
   Vector m_transform;
 
-  bool m_shouldLoadVars = false;
+  bool m_shouldRespawn = false;
   bool m_gameFinished = false;
 
-  std::map<int, std::unique_ptr<IVariable>> m_vars;
+  std::map<int, std::unique_ptr<Variable>> m_vars;
   std::vector<std::unique_ptr<Event>> m_eventQueue;
 
   SavedGame m_savedGame;
-  const Quest m_quest;
+  const std::shared_ptr<const Quest> m_questData;
+  const Quest& m_quest;
   Vec2i m_currRoomSize {};
 
   IPresenter* const m_view;
@@ -553,7 +851,6 @@ struct InGameScene : Scene, private IGame
   Body m_tilemapBody {};
   ShapeTilemap m_tilemapShape {};
 
-  const Matrix2<int>* m_tilesForDisplay;
   bool m_debug;
   bool m_debugFirstTime = true;
   Toggle startButton;
@@ -561,7 +858,11 @@ struct InGameScene : Scene, private IGame
   std::vector<std::unique_ptr<Entity>> m_entities;
   std::vector<std::unique_ptr<Entity>> m_spawned;
 
+  HashedSpace m_visibilityIndex;
+  bool m_visibilityIndexDirty = true;
+
   Vec2f m_cameraPos {};
+  Vec2f m_prevCameraPos {};
   Rect2f m_cameraArea {}; // the area where the center of the camera can go
 };
 }
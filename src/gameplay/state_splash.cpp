@@ -57,7 +57,7 @@ struct SplashState : Scene
     return this;
   }
 
-  void draw() override
+  void draw(float) override
   {
     {
       auto splash = SpriteActor { NullVector, MDL_SPLASH };
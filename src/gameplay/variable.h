@@ -38,6 +38,12 @@ struct Variable : IVariable
       observer(newValue);
   }
 
+  // used when restoring a snapshot: observers aren't notified
+  void restore(int newValue)
+  {
+    value = newValue;
+  }
+
   std::unique_ptr<Handle> observe(Observer&& observer) override
   {
     auto it = observers.insert(observers.begin(), std::move(observer));
@@ -49,6 +55,6 @@ struct Variable : IVariable
 
 private:
   std::list<Observer> observers;
-  int value;
+  int value = 0;
 };
 
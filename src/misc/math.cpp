@@ -12,3 +12,20 @@ Vec2f normalize(Vec2f a)
   return a * 1.0 / magnitude;
 }
 
+static thread_local uint32_t g_randomState = 1;
+
+void seedRandom(uint32_t seed)
+{
+  g_randomState = seed ? seed : 1;
+}
+
+int randomInt()
+{
+  // xorshift32
+  auto x = g_randomState;
+  x ^= x << 13;
+  x ^= x >> 17;
+  x ^= x << 5;
+  g_randomState = x;
+  return int(x >> 1);
+}
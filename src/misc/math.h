@@ -1,5 +1,6 @@
 #pragma once
 #include "base/geom.h"
+#include <cstdint>
 
 float dotProduct(Vec2f a, Vec2f b);
 Vec2f normalize(Vec2f a);
@@ -12,3 +13,8 @@ T lerp(T a, T b, float alpha)
   return a * (1 - alpha) + b * alpha;
 }
 
+// Deterministic pseudo-random numbers, in [0 .. 2^31[.
+// Each thread has its own generator, so parallel simulations
+// don't perturb each other.
+void seedRandom(uint32_t seed);
+int randomInt();
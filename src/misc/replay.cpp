@@ -0,0 +1,178 @@
+// Copyright (C) 2023 - Sebastien Alaiwan
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as
+// published by the Free Software Foundation, either version 3 of the
+// License, or (at your option) any later version.
+
+#include "replay.h"
+
+#include "base/error.h"
+
+namespace
+{
+const uint32_t ReplayMagic = 0x594C5052; // 'RPLY'
+const int HeaderSize = 16;
+
+bool Control::* const ControlBits[] =
+{
+  &Control::left,
+  &Control::right,
+  &Control::up,
+  &Control::down,
+  &Control::start,
+  &Control::fire,
+  &Control::jump,
+  &Control::dash,
+  &Control::restart,
+  &Control::debug,
+};
+
+uint16_t packControl(Control c)
+{
+  uint16_t r = 0;
+  int i = 0;
+
+  for(auto field : ControlBits)
+    r |= (c.*field) << i++;
+
+  return r;
+}
+
+Control unpackControl(uint16_t bits)
+{
+  Control c {};
+  int i = 0;
+
+  for(auto field : ControlBits)
+    c.*field = (bits >> i++) & 1;
+
+  return c;
+}
+
+void writeU32(std::vector<uint8_t>& dst, uint32_t val)
+{
+  for(int i = 0; i < 4; ++i)
+    dst.push_back((val >> (i * 8)) & 0xFF);
+}
+
+uint32_t readU32(const uint8_t* src)
+{
+  return src[0] | (src[1] << 8) | (src[2] << 16) | (uint32_t(src[3]) << 24);
+}
+
+void writeVarint(std::vector<uint8_t>& dst, uint32_t val)
+{
+  while(val >= 0x80)
+  {
+    dst.push_back((val & 0x7F) | 0x80);
+    val >>= 7;
+  }
+
+  dst.push_back(val);
+}
+}
+
+std::vector<uint8_t> serializeReplay(const Replay& replay)
+{
+  std::vector<uint8_t> r;
+  writeU32(r, ReplayMagic);
+  writeU32(r, replay.level);
+  writeU32(r, replay.seed);
+  writeU32(r, replay.tickCount);
+  r.insert(r.end(), replay.runs.begin(), replay.runs.end());
+  return r;
+}
+
+Replay deserializeReplay(Span<const uint8_t> data)
+{
+  if(data.len < HeaderSize || readU32(data.data) != ReplayMagic)
+    throw Error("Invalid replay file");
+
+  Replay r;
+  r.level = (int)readU32(data.data + 4);
+  r.seed = readU32(data.data + 8);
+  r.tickCount = (int)readU32(data.data + 12);
+  r.runs.assign(data.data + HeaderSize, data.data + data.len);
+  return r;
+}
+
+ReplayRecorder::ReplayRecorder(int level, uint32_t seed)
+{
+  m_replay.level = level;
+  m_replay.seed = seed;
+}
+
+void ReplayRecorder::record(Control c)
+{
+  auto bits = packControl(c);
+
+  if(m_count && bits != m_bits)
+  {
+    finish();
+  }
+
+  m_bits = bits;
+  ++m_count;
+}
+
+const Replay& ReplayRecorder::finish()
+{
+  if(m_count)
+  {
+    m_replay.runs.push_back(m_bits & 0xFF);
+    m_replay.runs.push_back(m_bits >> 8);
+    writeVarint(m_replay.runs, m_count);
+    m_replay.tickCount += m_count;
+    m_count = 0;
+  }
+
+  return m_replay;
+}
+
+ReplayPlayer::ReplayPlayer(const Replay& replay) : m_replay(replay)
+{
+}
+
+bool ReplayPlayer::next(Control& c)
+{
+  auto& runs = m_replay.runs;
+
+  if(m_count == 0)
+  {
+    if(m_pos + 2 > (int)runs.size())
+      return false;
+
+    m_bits = runs[m_pos] | (runs[m_pos + 1] << 8);
+    m_pos += 2;
+
+    uint32_t count = 0;
+    int shift = 0;
+
+    while(1)
+    {
+      if(m_pos >= (int)runs.size())
+        throw Error("Truncated replay");
+
+      // a run length fits in 5 bytes
+      if(shift > 28)
+        throw Error("Corrupt replay");
+
+      auto byte = runs[m_pos++];
+      count |= uint32_t(byte & 0x7F) << shift;
+      shift += 7;
+
+      if(!(byte & 0x80))
+        break;
+    }
+
+    // runs are never empty, and their length fits in an 'int'
+    if(count == 0 || count > 0x7FFFFFFF)
+      throw Error("Corrupt replay");
+
+    m_count = (int)count;
+  }
+
+  c = unpackControl(m_bits);
+  --m_count;
+  return true;
+}
@@ -0,0 +1,59 @@
+// Copyright (C) 2023 - Sebastien Alaiwan
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as
+// published by the Free Software Foundation, either version 3 of the
+// License, or (at your option) any later version.
+
+// Recording and playback of the player input stream.
+// A replay is the starting level, the RNG seed, and one 'Control' per
+// gameplay tick. Consecutive identical inputs are stored as a single run,
+// so several minutes of play typically fit in a few kilobytes.
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "base/scene.h"
+#include "base/span.h"
+
+struct Replay
+{
+  int level = -1; // -1: the game was started from the title screen
+  uint32_t seed = 0;
+  int tickCount = 0;
+  std::vector<uint8_t> runs; // (control bits, varint run length) pairs
+};
+
+std::vector<uint8_t> serializeReplay(const Replay& replay);
+Replay deserializeReplay(Span<const uint8_t> data);
+
+struct ReplayRecorder
+{
+  ReplayRecorder(int level, uint32_t seed);
+
+  // call once per gameplay tick
+  void record(Control c);
+
+  // flushes the pending run
+  const Replay& finish();
+
+private:
+  Replay m_replay;
+  uint16_t m_bits = 0;
+  int m_count = 0;
+};
+
+struct ReplayPlayer
+{
+  ReplayPlayer(const Replay& replay);
+
+  // returns false once the end of the replay has been reached
+  bool next(Control& c);
+
+private:
+  const Replay& m_replay;
+  int m_pos = 0;
+  uint16_t m_bits = 0;
+  int m_count = 0;
+};
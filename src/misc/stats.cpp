@@ -1,5 +1,7 @@
 // immediate-mode gathering of named statistics.
 // Values are smoothed over AVERAGE_PERIOD.
+// Each thread has its own set of values, so several games
+// can run in parallel (see main_headless.cpp).
 #include "stats.h"
 #include "time.h"
 #include <map>
@@ -48,11 +50,29 @@ struct StatTrack
       i = timedValues.erase(i);
     }
   }
+
+  // for values already smoothed by another thread
+  void setValue(double time, double value)
+  {
+    timedValues.clear();
+    timedValues[time] = value;
+  }
 };
 
+// Gauges are global objects: they're all registered before 'main'.
+int& g_GaugeCount()
+{
+  static int count;
+  return count;
+}
+
 std::vector<StatTrack>& g_Tracks()
 {
-  static std::vector<StatTrack> tracks;
+  thread_local std::vector<StatTrack> tracks;
+
+  if((int)tracks.size() < g_GaugeCount())
+    tracks.resize(g_GaugeCount());
+
   return tracks;
 }
 }
@@ -67,15 +87,36 @@ StatVal getStat(int idx)
   return g_Tracks().at(idx).getCurrValue();
 }
 
+void exportStats(std::vector<StatVal>& dst)
+{
+  dst.clear();
+
+  for(auto& track : g_Tracks())
+    dst.push_back(track.getCurrValue());
+}
+
+void importStats(const std::vector<StatVal>& src)
+{
+  auto timeNow = GetSteadyClockMs() / 1000.0;
+  auto& tracks = g_Tracks();
+
+  for(int i = 0; i < (int)src.size() && i < (int)tracks.size(); ++i)
+  {
+    if(!src[i].name)
+      continue;
+
+    tracks[i].name = src[i].name;
+    tracks[i].setValue(timeNow, src[i].val);
+  }
+}
+
 static const Gauge* gAllGauges;
 
 Gauge::Gauge(const char* name) :
   name(name),
   next(gAllGauges),
-  index(g_Tracks().size())
+  index(g_GaugeCount()++)
 {
-  g_Tracks().push_back({});
-
   gAllGauges = this;
 }
 
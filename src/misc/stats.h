@@ -1,5 +1,7 @@
 #pragma once
 
+#include <vector>
+
 struct StatVal
 {
   const char* name;
@@ -9,6 +11,12 @@ struct StatVal
 int getStatCount();
 StatVal getStat(int idx);
 
+// Gauge values are per-thread.
+// A helper thread (e.g the render thread) can forward
+// its own values to the thread displaying them.
+void exportStats(std::vector<StatVal>& dst);
+void importStats(const std::vector<StatVal>& src);
+
 struct Gauge
 {
   Gauge(const char* name);
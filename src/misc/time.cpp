@@ -1,6 +1,14 @@
 #include "time.h"
 
 #include <chrono>
+#include <thread>
+
+namespace
+{
+// how early we wake up before the deadline, to compensate for the OS
+// scheduler granularity.
+const int64_t SPIN_DURATION_US = 1000;
+}
 
 int64_t GetSteadyClockMs()
 {
@@ -9,3 +17,22 @@ int64_t GetSteadyClockMs()
   return duration_cast<milliseconds>(elapsedTime).count();
 }
 
+int64_t GetSteadyClockUs()
+{
+  using namespace std::chrono;
+  auto elapsedTime = steady_clock::now().time_since_epoch();
+  return duration_cast<microseconds>(elapsedTime).count();
+}
+
+void SleepUntilUs(int64_t deadlineUs)
+{
+  const auto remaining = deadlineUs - GetSteadyClockUs();
+
+  if(remaining > SPIN_DURATION_US)
+    std::this_thread::sleep_for(std::chrono::microseconds(remaining - SPIN_DURATION_US));
+
+  while(GetSteadyClockUs() < deadlineUs)
+  {
+  }
+}
+
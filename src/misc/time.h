@@ -3,4 +3,9 @@
 #include <cstdint>
 
 int64_t GetSteadyClockMs();
+int64_t GetSteadyClockUs();
+
+// Sleeps until 'deadlineUs' (as returned by GetSteadyClockUs).
+// The OS sleep is coarse, so the end of the wait is spent spinning.
+void SleepUntilUs(int64_t deadlineUs);
 
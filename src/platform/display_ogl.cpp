@@ -8,6 +8,7 @@
 // OpenGL stuff
 
 #include <cassert>
+#include <cstring> // memcpy
 #include <memory>
 #include <vector>
 
@@ -47,6 +48,125 @@ void ensureGl(char const* expr, const char* file, int line)
 namespace
 {
 Gauge ggDrawCalls("Draw calls");
+Gauge ggVboOrphans("VBO orphans");
+Gauge ggPendingUploads("pending texture uploads");
+Gauge ggGlCallsIssued("GL calls issued");
+Gauge ggGlCallsElided("GL calls elided");
+
+// only touched by the thread owning the GL context
+int g_vboOrphanCount = 0;
+
+// What's bound in the GL context, to skip the redundant calls.
+// Only touched by the thread owning the GL context.
+struct GlStateCache
+{
+  static constexpr int MaxTextureUnits = 8;
+
+  // counts the call as elided or issued. Returns true if it's redundant
+  bool skip(bool redundant)
+  {
+    if(redundant)
+      ++elidedCount;
+    else
+      ++issuedCount;
+
+    return redundant;
+  }
+
+  void useProgram(GLuint program_)
+  {
+    if(skip(program == program_))
+      return;
+
+    SAFE_GL(glUseProgram(program_));
+    program = program_;
+  }
+
+  void bindVertexArray(GLuint vao_)
+  {
+    if(skip(vao == vao_))
+      return;
+
+    SAFE_GL(glBindVertexArray(vao_));
+    vao = vao_;
+  }
+
+  void bindArrayBuffer(GLuint buffer)
+  {
+    if(skip(arrayBuffer == buffer))
+      return;
+
+    SAFE_GL(glBindBuffer(GL_ARRAY_BUFFER, buffer));
+    arrayBuffer = buffer;
+  }
+
+  void bindTexture(int unit, GLuint texture)
+  {
+    if(unit < 0 || unit >= MaxTextureUnits)
+      throw Error("Texture unit out of range");
+
+    if(skip(textures[unit] == texture))
+      return;
+
+    if(activeUnit != unit)
+    {
+      SAFE_GL(glActiveTexture(GL_TEXTURE0 + unit));
+      activeUnit = unit;
+      ++issuedCount;
+    }
+
+    SAFE_GL(glBindTexture(GL_TEXTURE_2D, texture));
+    textures[unit] = texture;
+  }
+
+  // for editing the texture: keeps the active unit
+  void bindTexture(GLuint texture)
+  {
+    bindTexture(activeUnit, texture);
+  }
+
+  void enableDepthTest(bool enable)
+  {
+    if(skip(depthTest == enable))
+      return;
+
+    if(enable)
+      SAFE_GL(glEnable(GL_DEPTH_TEST));
+    else
+      SAFE_GL(glDisable(GL_DEPTH_TEST));
+
+    depthTest = enable;
+  }
+
+  // deleted textures get unbound from all the units
+  void forgetTexture(GLuint texture)
+  {
+    for(auto& t : textures)
+    {
+      if(t == texture)
+        t = 0;
+    }
+  }
+
+  // the initial state of a GL context
+  GLuint program = 0;
+  GLuint vao = 0;
+  GLuint arrayBuffer = 0;
+  int activeUnit = 0;
+  GLuint textures[MaxTextureUnits] {};
+  bool depthTest = false;
+
+  // contents of the uniform buffer, and where it's bound
+  std::vector<uint8_t> uniformBlock;
+  int uniformBinding = -1;
+
+  int bufferSerialCount = 0; // unlike GL names, serials don't get reused
+
+  int issuedCount = 0;
+  int elidedCount = 0;
+};
+
+GlStateCache g_glState;
 
 const float AspectRatio = 1.5;
 
@@ -137,39 +257,247 @@ void printOpenGlVersion()
          notNull(glGetString(GL_VENDOR)));
 }
 
+GLenum toGlType(AttributeType type)
+{
+  switch(type)
+  {
+  case AttributeType::Float: return GL_FLOAT;
+  case AttributeType::Short: return GL_SHORT;
+  case AttributeType::UnsignedShort: return GL_UNSIGNED_SHORT;
+  case AttributeType::Byte: return GL_BYTE;
+  case AttributeType::UnsignedByte: return GL_UNSIGNED_BYTE;
+  }
+
+  throw Error("Unknown vertex attribute type");
+}
+
 struct OpenGlProgram : IGpuProgram
 {
+  static constexpr int MaxAttributes = 8;
+
   OpenGlProgram(GLuint program_, bool zTest_) : program(program_), zTest(zTest_)
   {
     uniformBlockIndex = glGetUniformBlockIndex(program, "MyUniformBlock");
+    SAFE_GL(glGenVertexArrays(1, &vao));
   }
 
   ~OpenGlProgram()
   {
+    if(g_glState.program == program)
+      g_glState.program = 0;
+
+    if(g_glState.vao == vao)
+      g_glState.vao = 0;
+
+    glDeleteVertexArrays(1, &vao);
     glDeleteProgram(program);
   }
 
+  // as last specified in the vertex array
+  struct Attribute
+  {
+    int bufferSerial = 0; // 0: disabled
+    int dim = 0;
+    int stride = 0;
+    int offset = 0;
+    GLenum type = GL_FLOAT;
+    bool normalized = false;
+    int divisor = 0;
+
+    bool operator == (const Attribute& other) const
+    {
+      return bufferSerial == other.bufferSerial
+             && dim == other.dim
+             && stride == other.stride
+             && offset == other.offset
+             && type == other.type
+             && normalized == other.normalized
+             && divisor == other.divisor;
+    }
+  };
+
   int uniformBlockIndex = -1;
   const GLuint program;
   const bool zTest;
+
+  // one vertex array per program: each program always gets fed the same way,
+  // so the attribute setup mostly happens once.
+  GLuint vao;
+  Attribute attributes[MaxAttributes];
+};
+
+// Pixel unpack buffers, for texture uploads that don't block the CPU:
+// glTexSubImage2D returns as soon as the copy from the buffer is queued,
+// and later draws see the new texels anyway.
+// A buffer gets reused once its fence tells the GPU is done with it.
+struct UploadStaging
+{
+  static constexpr int MaxBuffers = 8;
+
+  // 'write' fills the staging memory, 'copy' issues the texture copy from 'src'
+  template<typename WriteFunc, typename CopyFunc>
+  void upload(int size, WriteFunc write, CopyFunc copy)
+  {
+    if(size == 0)
+      return;
+
+#ifdef __EMSCRIPTEN__
+    // WebGL has no buffer mapping: synchronous copy, from client memory
+    m_scratch.resize(size);
+    write(m_scratch.data());
+    copy(m_scratch.data());
+#else
+    auto& buffer = acquire(size);
+
+    SAFE_GL(glBindBuffer(GL_PIXEL_UNPACK_BUFFER, buffer.pbo));
+
+    // if the buffer is still being read, the driver gives us fresh storage
+    auto const flags = GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT;
+    auto dst = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, size, flags);
+
+    if(!dst)
+      throw Error("Can't map pixel unpack buffer");
+
+    write((uint8_t*)dst);
+    SAFE_GL(glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER));
+
+    copy(nullptr); // offset in the bound buffer
+
+    SAFE_GL(glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0));
+    buffer.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+#endif
+  }
+
+  // forgets the fences of the completed copies
+  void poll()
+  {
+    for(auto& buffer : m_buffers)
+    {
+      if(!buffer.fence)
+        continue;
+
+      auto const status = glClientWaitSync(buffer.fence, 0, 0);
+
+      if(status == GL_ALREADY_SIGNALED || status == GL_CONDITION_SATISFIED)
+      {
+        glDeleteSync(buffer.fence);
+        buffer.fence = nullptr;
+      }
+    }
+  }
+
+  int pendingCount() const
+  {
+    int r = 0;
+
+    for(auto& buffer : m_buffers)
+      r += buffer.fence ? 1 : 0;
+
+    return r;
+  }
+
+  // must be called while the GL context is still alive
+  void release()
+  {
+    for(auto& buffer : m_buffers)
+    {
+      if(buffer.fence)
+        glDeleteSync(buffer.fence);
+
+      glDeleteBuffers(1, &buffer.pbo);
+    }
+
+    m_buffers.clear();
+  }
+
+private:
+  struct Buffer
+  {
+    GLuint pbo = 0;
+    int capacity = 0;
+    GLsync fence = nullptr; // the pending copy from this buffer
+    int lastUse = 0;
+  };
+
+  // an idle buffer if there's one, a new one while there are few,
+  // otherwise the least recently used one (it will get orphaned when mapped)
+  Buffer& acquire(int size)
+  {
+    poll();
+
+    Buffer* r = nullptr;
+
+    for(auto& buffer : m_buffers)
+    {
+      if(!buffer.fence && (!r || buffer.capacity > r->capacity))
+        r = &buffer;
+    }
+
+    if(!r && (int)m_buffers.size() < MaxBuffers)
+    {
+      m_buffers.push_back({});
+      r = &m_buffers.back();
+      SAFE_GL(glGenBuffers(1, &r->pbo));
+    }
+
+    if(!r)
+    {
+      r = &m_buffers[0];
+
+      for(auto& buffer : m_buffers)
+      {
+        if(buffer.lastUse < r->lastUse)
+          r = &buffer;
+      }
+
+      glDeleteSync(r->fence);
+      r->fence = nullptr;
+    }
+
+    if(r->capacity < size)
+    {
+      SAFE_GL(glBindBuffer(GL_PIXEL_UNPACK_BUFFER, r->pbo));
+      SAFE_GL(glBufferData(GL_PIXEL_UNPACK_BUFFER, size, nullptr, GL_STREAM_DRAW));
+      SAFE_GL(glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0));
+      r->capacity = size;
+    }
+
+    r->lastUse = ++m_useCount;
+    return *r;
+  }
+
+  std::vector<Buffer> m_buffers;
+  int m_useCount = 0;
+  std::vector<uint8_t> m_scratch;
 };
 
 struct OpenGlTexture : ITexture
 {
-  OpenGlTexture()
+  // the textures of frame buffers don't get uploaded to: no staging
+  OpenGlTexture(UploadStaging* staging_ = nullptr) : staging(staging_)
   {
     SAFE_GL(glGenTextures(1, &texture));
   }
 
   ~OpenGlTexture()
   {
+    g_glState.forgetTexture(texture);
     glDeleteTextures(1, &texture);
   }
 
-  void create(Vec2i dim) override
+  void create(Vec2i dim, TextureFormat format) override
   {
-    glBindTexture(GL_TEXTURE_2D, texture);
-    SAFE_GL(glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, dim.x, dim.y, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr));
+    GLenum internalFormat = GL_RGBA;
+
+    switch(format)
+    {
+    case TextureFormat::Rgba8: internalFormat = GL_RGBA; dataFormat = GL_RGBA; dataType = GL_UNSIGNED_BYTE; texelSize = 4; break;
+    case TextureFormat::R16ui: internalFormat = GL_R16UI; dataFormat = GL_RED_INTEGER; dataType = GL_UNSIGNED_SHORT; texelSize = 2; break;
+    case TextureFormat::Rgba32f: internalFormat = GL_RGBA32F; dataFormat = GL_RGBA; dataType = GL_FLOAT; texelSize = 16; break;
+    }
+
+    g_glState.bindTexture(texture);
+    SAFE_GL(glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, dim.x, dim.y, 0, dataFormat, dataType, nullptr));
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
@@ -179,43 +507,73 @@ struct OpenGlTexture : ITexture
   {
     const int bpp = 4;
     const Vec2i dim = pic.dim;
-    std::vector<uint8_t> img(dim.x * dim.y * bpp);
 
-    {
-      // Flip the picture upside down
-      // from glTexImage2D doc:
-      // "The first element corresponds to the lower left corner of the texture image",
-      // (e.g (u,v) = (0,0))
-      auto src = pic.pixels;
-      auto dst = img.data() + bpp * dim.x * dim.y;
-
-      for(int y = 0; y < dim.y; ++y)
+    // Flip the picture upside down, while writing it to the staging buffer
+    // from glTexImage2D doc:
+    // "The first element corresponds to the lower left corner of the texture image",
+    // (e.g (u,v) = (0,0))
+    auto write = [&] (uint8_t* dst)
       {
-        dst -= bpp * dim.x;
-        memcpy(dst, src, bpp * dim.x);
-        src += pic.stride * bpp;
-      }
-    }
+        auto src = pic.pixels;
+        dst += bpp * dim.x * dim.y;
+
+        for(int y = 0; y < dim.y; ++y)
+        {
+          dst -= bpp * dim.x;
+          memcpy(dst, src, bpp * dim.x);
+          src += pic.stride * bpp;
+        }
+      };
 
-    glBindTexture(GL_TEXTURE_2D, texture);
-    SAFE_GL(glTexSubImage2D(GL_TEXTURE_2D, 0, dstPos.x, dstPos.y, pic.dim.x, pic.dim.y, GL_RGBA, GL_UNSIGNED_BYTE, img.data()));
-    glBindTexture(GL_TEXTURE_2D, 0);
+    auto copy = [&] (const void* src)
+      {
+        g_glState.bindTexture(texture);
+        SAFE_GL(glTexSubImage2D(GL_TEXTURE_2D, 0, dstPos.x, dstPos.y, dim.x, dim.y, GL_RGBA, GL_UNSIGNED_BYTE, src));
+      };
+
+    staging->upload(bpp * dim.x * dim.y, write, copy);
+  }
+
+  void uploadRaw(const void* texels, Vec2i dim, Vec2i dstPos) override
+  {
+    // rows of 16-bit texels aren't always 4-byte aligned
+    glPixelStorei(GL_UNPACK_ALIGNMENT, texelSize % 4 ? 1 : 4);
+
+    const int size = dim.x * dim.y * texelSize;
+
+    auto write = [&] (uint8_t* dst)
+      {
+        memcpy(dst, texels, size);
+      };
+
+    auto copy = [&] (const void* src)
+      {
+        g_glState.bindTexture(texture);
+        SAFE_GL(glTexSubImage2D(GL_TEXTURE_2D, 0, dstPos.x, dstPos.y, dim.x, dim.y, dataFormat, dataType, src));
+      };
+
+    staging->upload(size, write, copy);
+
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
   }
 
   void setNoRepeat() override
   {
-    glBindTexture(GL_TEXTURE_2D, texture);
+    g_glState.bindTexture(texture);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
   }
 
   void bind(int unit) override
   {
-    SAFE_GL(glActiveTexture(GL_TEXTURE0 + unit));
-    SAFE_GL(glBindTexture(GL_TEXTURE_2D, texture));
+    g_glState.bindTexture(unit, texture);
   }
 
+  UploadStaging* const staging;
   GLuint texture;
+  GLenum dataFormat = GL_RGBA;
+  GLenum dataType = GL_UNSIGNED_BYTE;
+  int texelSize = 4;
 };
 
 struct OpenGlFrameBuffer : IFrameBuffer
@@ -230,7 +588,7 @@ struct OpenGlFrameBuffer : IFrameBuffer
     {
       auto depthTexture = std::make_unique<OpenGlTexture>();
 
-      SAFE_GL(glBindTexture(GL_TEXTURE_2D, depthTexture->texture));
+      g_glState.bindTexture(depthTexture->texture);
       SAFE_GL(glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH24_STENCIL8, resolution.x, resolution.y, 0, GL_DEPTH_STENCIL, GL_UNSIGNED_INT_24_8, NULL));
       SAFE_GL(glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_TEXTURE_2D, depthTexture->texture, 0));
 
@@ -241,7 +599,7 @@ struct OpenGlFrameBuffer : IFrameBuffer
     {
       auto colorTexture = std::make_unique<OpenGlTexture>();
 
-      SAFE_GL(glBindTexture(GL_TEXTURE_2D, colorTexture->texture));
+      g_glState.bindTexture(colorTexture->texture);
       SAFE_GL(glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16F, resolution.x, resolution.y, 0, GL_RGBA, GL_FLOAT, nullptr));
       SAFE_GL(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST));
       SAFE_GL(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST));
@@ -271,24 +629,80 @@ struct OpenGlFrameBuffer : IFrameBuffer
 
 struct OpenGlVertexBuffer : IVertexBuffer
 {
-  OpenGlVertexBuffer()
+  // initial size of the storage used by 'append'
+  static constexpr int StreamCapacity = 1024 * 1024;
+
+  OpenGlVertexBuffer() : serial(++g_glState.bufferSerialCount)
   {
     SAFE_GL(glGenBuffers(1, &vbo));
   }
 
   ~OpenGlVertexBuffer()
   {
+    // deleted buffers get unbound
+    if(g_glState.arrayBuffer == vbo)
+      g_glState.arrayBuffer = 0;
+
     glDeleteBuffers(1, &vbo);
   }
 
   void upload(const void* data, size_t len) override
   {
-    SAFE_GL(glBindBuffer(GL_ARRAY_BUFFER, vbo));
+    g_glState.bindArrayBuffer(vbo);
     SAFE_GL(glBufferData(GL_ARRAY_BUFFER, len, data, GL_DYNAMIC_DRAW));
-    SAFE_GL(glBindBuffer(GL_ARRAY_BUFFER, 0));
+
+    // the next 'append' will reallocate the storage
+    capacity = (int)len;
+    cursor = capacity;
+  }
+
+  int append(const void* data, int vertexCount, int vertexSize) override
+  {
+    const int len = vertexCount * vertexSize;
+
+    // vertices are addressed by index: align the cursor on the vertex size
+    int offset = (cursor + vertexSize - 1) / vertexSize * vertexSize;
+
+    g_glState.bindArrayBuffer(vbo);
+
+    if(offset + len > capacity)
+    {
+      // orphan the storage: the driver keeps the old one alive
+      // until the GPU is done with it, we get a fresh one.
+      while(capacity < len || capacity < StreamCapacity)
+        capacity = capacity ? capacity * 2 : StreamCapacity;
+
+      SAFE_GL(glBufferData(GL_ARRAY_BUFFER, capacity, nullptr, GL_STREAM_DRAW));
+      offset = 0;
+      ++g_vboOrphanCount;
+    }
+
+#ifdef __EMSCRIPTEN__
+    // WebGL has no buffer mapping
+    SAFE_GL(glBufferSubData(GL_ARRAY_BUFFER, offset, len, data));
+#else
+    // nothing past the cursor is used by pending draws: no need to synchronize
+    auto const flags = GL_MAP_WRITE_BIT | GL_MAP_UNSYNCHRONIZED_BIT | GL_MAP_INVALIDATE_RANGE_BIT;
+    auto dst = glMapBufferRange(GL_ARRAY_BUFFER, offset, len, flags);
+
+    if(!dst)
+      throw Error("Can't map vertex buffer");
+
+    memcpy(dst, data, len);
+    SAFE_GL(glUnmapBuffer(GL_ARRAY_BUFFER));
+#endif
+
+    cursor = offset + len;
+
+    return offset / vertexSize;
   }
 
   GLuint vbo;
+  const int serial; // identifies the buffer in the vertex array layouts
+
+  // streaming state, in bytes
+  int capacity = 0;
+  int cursor = 0;
 };
 
 struct OpenGlGraphicsBackend : IGraphicsBackend
@@ -338,14 +752,12 @@ struct OpenGlGraphicsBackend : IGraphicsBackend
 
     printOpenGlVersion();
 
+    // a fresh context
+    g_glState = {};
+
     // Enable vsync
     SDL_GL_SetSwapInterval(1);
 
-    // Create our unique vertex array
-    GLuint VertexArrayID;
-    SAFE_GL(glGenVertexArrays(1, &VertexArrayID));
-    SAFE_GL(glBindVertexArray(VertexArrayID));
-
     // Create our unique uniform buffer
     SAFE_GL(glGenBuffers(1, &m_uniformBuffer));
 
@@ -359,6 +771,7 @@ struct OpenGlGraphicsBackend : IGraphicsBackend
 
   ~OpenGlGraphicsBackend()
   {
+    m_staging.release();
     SAFE_GL(glDeleteBuffers(1, &m_uniformBuffer));
     SAFE_GL(glBindFramebuffer(GL_FRAMEBUFFER, 0));
 
@@ -375,6 +788,30 @@ struct OpenGlGraphicsBackend : IGraphicsBackend
     SDL_SetWindowFullscreen(m_window, flags);
   }
 
+  bool setVsync(bool enable) override
+  {
+    return SDL_GL_SetSwapInterval(enable ? 1 : 0) == 0;
+  }
+
+  void makeCurrent(bool current) override
+  {
+    if(SDL_GL_MakeCurrent(m_window, current ? m_context : nullptr))
+    {
+      char buffer[256];
+      throw Error(format(buffer, "Can't make the OpenGL context current: %s", SDL_GetError()));
+    }
+  }
+
+  int getRefreshRate() override
+  {
+    SDL_DisplayMode mode {};
+
+    if(SDL_GetCurrentDisplayMode(SDL_GetWindowDisplayIndex(m_window), &mode))
+      return 0;
+
+    return mode.refresh_rate;
+  }
+
   void setCaption(String caption) override
   {
     SDL_SetWindowTitle(m_window, caption.data);
@@ -411,7 +848,7 @@ struct OpenGlGraphicsBackend : IGraphicsBackend
 
   std::unique_ptr<ITexture> createTexture() override
   {
-    return std::make_unique<OpenGlTexture>();
+    return std::make_unique<OpenGlTexture>(&m_staging);
   }
 
   std::unique_ptr<IGpuProgram> createGpuProgram(String name_, bool zTest) override
@@ -429,31 +866,105 @@ struct OpenGlGraphicsBackend : IGraphicsBackend
     return std::make_unique<OpenGlProgram>(loadShaders(toSpan(vsCode), toSpan(fsCode)), zTest);
   }
 
+  void setSamplerUnit(IGpuProgram* iprogram, String name_, int unit) override
+  {
+    auto program = dynamic_cast<OpenGlProgram*>(iprogram);
+    const std::string name(name_.data, name_.len);
+
+    auto const location = glGetUniformLocation(program->program, name.c_str());
+
+    if(location < 0)
+    {
+      char buffer[256];
+      throw Error(format(buffer, "No such sampler: '%s'", name.c_str()));
+    }
+
+    g_glState.useProgram(program->program);
+    SAFE_GL(glUniform1i(location, unit));
+    g_glState.useProgram(m_currProgram ? m_currProgram->program : 0);
+  }
+
   void useGpuProgram(IGpuProgram* iprogram) override
   {
     auto program = dynamic_cast<OpenGlProgram*>(iprogram);
-    SAFE_GL(glUseProgram(program->program));
-    enableZTest(program->zTest);
+    g_glState.useProgram(program->program);
+    g_glState.bindVertexArray(program->vao);
+    g_glState.enableDepthTest(program->zTest);
     m_currProgram = program;
   }
 
+  // the buffer gets bound when an attribute gets specified
   void useVertexBuffer(IVertexBuffer* ivb) override
   {
-    auto vb = dynamic_cast<OpenGlVertexBuffer*>(ivb);
-    SAFE_GL(glBindBuffer(GL_ARRAY_BUFFER, vb->vbo));
+    m_currVertexBuffer = dynamic_cast<OpenGlVertexBuffer*>(ivb);
+  }
+
+  void enableVertexAttribute(int id, int dim, int stride, int offset, AttributeType type, bool normalized) override
+  {
+    OpenGlProgram::Attribute attr;
+    attr.dim = dim;
+    attr.stride = stride;
+    attr.offset = offset;
+    attr.type = toGlType(type);
+    attr.normalized = normalized;
+    attr.divisor = 0;
+    setAttribute(id, attr);
   }
 
-  void enableVertexAttribute(int id, int dim, int stride, int offset) override
+  void enableInstanceAttribute(int id, int dim, int stride, int offset, AttributeType type, bool normalized) override
   {
-    SAFE_GL(glEnableVertexAttribArray(id));
-    SAFE_GL(glVertexAttribPointer(id, dim, GL_FLOAT, GL_FALSE, stride, (void*)(uintptr_t)offset));
+    OpenGlProgram::Attribute attr;
+    attr.dim = dim;
+    attr.stride = stride;
+    attr.offset = offset;
+    attr.type = toGlType(type);
+    attr.normalized = normalized;
+    attr.divisor = 1;
+    setAttribute(id, attr);
+  }
+
+  // specifies the attribute in the vertex array of the current program,
+  // unless it's already specified this way.
+  void setAttribute(int id, OpenGlProgram::Attribute attr)
+  {
+    if(id < 0 || id >= OpenGlProgram::MaxAttributes)
+      throw Error("Vertex attribute out of range");
+
+    attr.bufferSerial = m_currVertexBuffer->serial;
+
+    auto& curr = m_currProgram->attributes[id];
+
+    if(g_glState.skip(curr == attr))
+      return;
+
+    if(!curr.bufferSerial)
+      SAFE_GL(glEnableVertexAttribArray(id));
+
+    g_glState.bindArrayBuffer(m_currVertexBuffer->vbo);
+    SAFE_GL(glVertexAttribPointer(id, attr.dim, attr.type, attr.normalized ? GL_TRUE : GL_FALSE, attr.stride, (void*)(uintptr_t)attr.offset));
+
+    if(curr.divisor != attr.divisor)
+      SAFE_GL(glVertexAttribDivisor(id, attr.divisor));
+
+    curr = attr;
   }
 
   void setUniformBlock(void* ptr, size_t size) override
   {
+    auto bytes = (const uint8_t*)ptr;
+    auto& cached = g_glState.uniformBlock;
+    const int binding = m_currProgram->uniformBlockIndex;
+
+    // the same contents are already there
+    if(g_glState.skip(g_glState.uniformBinding == binding && cached.size() == size && memcmp(cached.data(), bytes, size) == 0))
+      return;
+
     glBindBuffer(GL_UNIFORM_BUFFER, m_uniformBuffer);
     glBufferData(GL_UNIFORM_BUFFER, size, ptr, GL_DYNAMIC_DRAW);
-    glBindBufferBase(GL_UNIFORM_BUFFER, m_currProgram->uniformBlockIndex, m_uniformBuffer);
+    glBindBufferBase(GL_UNIFORM_BUFFER, binding, m_uniformBuffer);
+
+    cached.assign(bytes, bytes + size);
+    g_glState.uniformBinding = binding;
   }
 
   std::unique_ptr<IVertexBuffer> createVertexBuffer() override
@@ -483,17 +994,15 @@ struct OpenGlGraphicsBackend : IGraphicsBackend
     }
   }
 
-  void enableZTest(bool enable)
+  void draw(int vertexCount, int firstVertex) override
   {
-    if(enable)
-      SAFE_GL(glEnable(GL_DEPTH_TEST));
-    else
-      SAFE_GL(glDisable(GL_DEPTH_TEST));
+    SAFE_GL(glDrawArrays(GL_TRIANGLES, firstVertex, vertexCount));
+    ++m_drawCallCount;
   }
 
-  void draw(int vertexCount) override
+  void drawInstanced(int vertexCount, int instanceCount) override
   {
-    SAFE_GL(glDrawArrays(GL_TRIANGLES, 0, vertexCount));
+    SAFE_GL(glDrawArraysInstanced(GL_TRIANGLES, 0, vertexCount, instanceCount));
     ++m_drawCallCount;
   }
 
@@ -509,6 +1018,16 @@ struct OpenGlGraphicsBackend : IGraphicsBackend
     updateScreenSize();
     ggDrawCalls = m_drawCallCount;
     m_drawCallCount = 0;
+    ggVboOrphans = g_vboOrphanCount;
+    g_vboOrphanCount = 0;
+
+    m_staging.poll();
+    ggPendingUploads = m_staging.pendingCount();
+
+    ggGlCallsIssued = g_glState.issuedCount;
+    ggGlCallsElided = g_glState.elidedCount;
+    g_glState.issuedCount = 0;
+    g_glState.elidedCount = 0;
   }
 
   void updateScreenSize()
@@ -560,7 +1079,9 @@ private:
   SDL_Window* m_window;
   SDL_GLContext m_context;
   GLuint m_uniformBuffer {};
-  const OpenGlProgram* m_currProgram;
+  UploadStaging m_staging;
+  OpenGlProgram* m_currProgram = nullptr;
+  OpenGlVertexBuffer* m_currVertexBuffer = nullptr;
 };
 }
 
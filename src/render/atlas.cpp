@@ -0,0 +1,182 @@
+// Copyright (C) 2025 - Sebastien Alaiwan
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as
+// published by the Free Software Foundation, either version 3 of the
+// License, or (at your option) any later version.
+
+#include "atlas.h"
+
+#include <algorithm> // max
+#include <climits> // INT_MAX
+
+SkylinePacker::SkylinePacker(Vec2i size) : m_size(size)
+{
+  reset();
+}
+
+void SkylinePacker::reset()
+{
+  m_skyline = { Segment{ 0, 0, m_size.x } };
+  m_usedArea = 0;
+}
+
+int SkylinePacker::coveredArea() const
+{
+  int area = 0;
+
+  for(auto& segment : m_skyline)
+    area += segment.y * segment.width;
+
+  return area;
+}
+
+bool SkylinePacker::fits(int i, Vec2i dim, int& y) const
+{
+  if(m_skyline[i].x + dim.x > m_size.x)
+    return false;
+
+  y = 0;
+  int widthLeft = dim.x;
+
+  // the rectangle rests on the highest segment below it
+  for(int j = i; widthLeft > 0; ++j)
+  {
+    y = std::max(y, m_skyline[j].y);
+
+    if(y + dim.y > m_size.y)
+      return false;
+
+    widthLeft -= m_skyline[j].width;
+  }
+
+  return true;
+}
+
+bool SkylinePacker::insert(Vec2i dim, Vec2i& pos)
+{
+  int bestIndex = -1;
+  int bestTop = INT_MAX;
+  int bestWidth = INT_MAX;
+
+  for(int i = 0; i < (int)m_skyline.size(); ++i)
+  {
+    int y;
+
+    if(!fits(i, dim, y))
+      continue;
+
+    // the lowest top, then the narrowest segment
+    const int top = y + dim.y;
+
+    if(top < bestTop || (top == bestTop && m_skyline[i].width < bestWidth))
+    {
+      bestIndex = i;
+      bestTop = top;
+      bestWidth = m_skyline[i].width;
+      pos = { m_skyline[i].x, y };
+    }
+  }
+
+  if(bestIndex < 0)
+    return false;
+
+  m_skyline.insert(m_skyline.begin() + bestIndex, Segment{ pos.x, pos.y + dim.y, dim.x });
+
+  // the segments now below the rectangle get shortened, or removed
+  const int right = pos.x + dim.x;
+
+  for(int i = bestIndex + 1; i < (int)m_skyline.size();)
+  {
+    auto& segment = m_skyline[i];
+
+    if(segment.x >= right)
+      break;
+
+    const int overlap = right - segment.x;
+    segment.x += overlap;
+    segment.width -= overlap;
+
+    if(segment.width > 0)
+      break;
+
+    m_skyline.erase(m_skyline.begin() + i);
+  }
+
+  // merge neighbours at the same height
+  for(int i = 0; i + 1 < (int)m_skyline.size();)
+  {
+    if(m_skyline[i].y == m_skyline[i + 1].y)
+    {
+      m_skyline[i].width += m_skyline[i + 1].width;
+      m_skyline.erase(m_skyline.begin() + i + 1);
+    }
+    else
+    {
+      ++i;
+    }
+  }
+
+  m_usedArea += dim.x * dim.y;
+  return true;
+}
+
+bool repackAtlasPage(std::vector<SkylinePacker>& pages, int pageIdx, const std::vector<Vec2i>& dims, int maxPages, std::vector<AtlasPlacement>& placements)
+{
+  // planned on copies: nothing changes if it fails halfway
+  auto packers = pages;
+  packers[pageIdx].reset();
+
+  placements.resize(dims.size());
+
+  for(int i = 0; i < (int)dims.size(); ++i)
+  {
+    auto& placement = placements[i];
+    placement.page = pageIdx;
+
+    if(packers[pageIdx].insert(dims[i], placement.pos))
+      continue;
+
+    // doesn't fit back: moved to another page
+    for(placement.page = 0; placement.page < (int)packers.size(); ++placement.page)
+    {
+      if(placement.page != pageIdx && packers[placement.page].insert(dims[i], placement.pos))
+        break;
+    }
+
+    if(placement.page < (int)packers.size())
+      continue;
+
+    if((int)packers.size() >= maxPages)
+      return false;
+
+    packers.push_back(SkylinePacker(pages[pageIdx].size()));
+
+    if(!packers.back().insert(dims[i], placement.pos))
+      return false;
+  }
+
+  pages = std::move(packers);
+  return true;
+}
+
+void computeAtlasUV(Vec2i atlasSize, Vec2i regionPos, Vec2i regionDim, Rect2f frect, Vec2f uv[2])
+{
+  const float texLocalLeft = frect.pos.x;
+  const float texLocalRight = frect.pos.x + frect.size.x;
+  const float texLocalTop = 1 - frect.pos.y;
+  const float texLocalBottom = 1 - (frect.pos.y + frect.size.y);
+
+  const int leftInPixels = regionPos.x + (texLocalLeft * regionDim.x);
+  const int rightInPixels = regionPos.x + (texLocalRight * regionDim.x);
+  const int topInPixels = regionPos.y + (texLocalTop * regionDim.y);
+  const int bottomInPixels = regionPos.y + (texLocalBottom * regionDim.y);
+
+  const float left = leftInPixels / float(atlasSize.x);
+  const float right = rightInPixels / float(atlasSize.x);
+  const float top = 1 - topInPixels / float(atlasSize.y);
+  const float bottom = 1 - bottomInPixels / float(atlasSize.y);
+
+  uv[0] = { left, top };
+  uv[1] = { right, bottom };
+}
+
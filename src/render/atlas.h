@@ -0,0 +1,70 @@
+// Copyright (C) 2025 - Sebastien Alaiwan
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as
+// published by the Free Software Foundation, either version 3 of the
+// License, or (at your option) any later version.
+
+// Rectangle packing, for texture atlases.
+// The top edge of the packed rectangles (the 'skyline') is kept as a list of
+// horizontal segments. Each new rectangle goes where its top ends up the lowest.
+// Rectangles can't be removed one by one: the owner packs the remaining ones
+// again, after a 'reset'.
+
+#pragma once
+
+#include <vector>
+
+#include "base/box.h"
+#include "base/geom.h"
+
+struct SkylinePacker
+{
+  SkylinePacker(Vec2i size);
+
+  // returns false if there's no room left for 'dim'
+  bool insert(Vec2i dim, Vec2i& pos);
+
+  // forgets all the rectangles
+  void reset();
+
+  Vec2i size() const { return m_size; }
+
+  // sum of the areas of the inserted rectangles
+  int usedArea() const { return m_usedArea; }
+
+  // area below the skyline: used, or lost for packing
+  int coveredArea() const;
+
+private:
+  struct Segment
+  {
+    int x, y;
+    int width;
+  };
+
+  // 'y' receives the height where 'dim' would be put, on top of segment 'i'
+  bool fits(int i, Vec2i dim, int& y) const;
+
+  Vec2i m_size;
+  std::vector<Segment> m_skyline; // sorted by 'x', covering the whole width
+  int m_usedArea = 0;
+};
+
+struct AtlasPlacement
+{
+  int page;
+  Vec2i pos;
+};
+
+// Packs the rectangles 'dims' of page 'pageIdx' again, in this order, after a
+// reset. The ones that don't fit back go to the other pages, or to new pages,
+// up to 'maxPages'. On success, 'pages' receives the new packers, and
+// 'placements' one placement per rectangle.
+// Returns false if some rectangle doesn't fit anywhere: 'pages' is left as is.
+bool repackAtlasPage(std::vector<SkylinePacker>& pages, int pageIdx, const std::vector<Vec2i>& dims, int maxPages, std::vector<AtlasPlacement>& placements);
+
+// UVs of the part 'frect' (in [0;1]) of a picture uploaded at 'regionPos'
+// in an atlas texture of size 'atlasSize'.
+// uv[0] is the left-top corner, uv[1] the right-bottom one.
+void computeAtlasUV(Vec2i atlasSize, Vec2i regionPos, Vec2i regionDim, Rect2f frect, Vec2f uv[2]);
+
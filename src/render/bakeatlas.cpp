@@ -0,0 +1,186 @@
+// Copyright (C) 2025 - Sebastien Alaiwan
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as
+// published by the Free Software Foundation, either version 3 of the
+// License, or (at your option) any later version.
+
+// Build-time tool: packs the pictures of the given models into atlas pages,
+// and writes them, with the UVs of each frame, to a baked atlas file.
+// The models are named by the paths the game loads them from.
+
+#include "atlas.h"
+#include "baked_atlas.h"
+#include "base/error.h"
+#include "misc/file.h"
+#include "model.h"
+#include "picture.h"
+
+#include <algorithm> // sort
+#include <cstdio>
+#include <cstring> // memcpy
+#include <map>
+
+namespace
+{
+// the minimum texture size guaranteed by GLES3. Pages get trimmed to their used height.
+const Vec2i PageSize = { 2048, 2048 };
+
+struct Region
+{
+  Picture pic;
+  int page = -1;
+  Vec2i pos;
+};
+
+struct Frame
+{
+  std::string path; // of the picture
+  Rect2f frect;
+};
+
+BakedAtlasContent bake(const std::vector<std::string>& modelPaths)
+{
+  std::vector<Frame> frames;
+  std::vector<Model> models;
+
+  for(auto& path : modelPaths)
+  {
+    auto collect = [&] (String picturePath, Rect2f frect)
+      {
+        frames.push_back({ std::string(picturePath.data, picturePath.len), frect });
+        return (int)frames.size() - 1;
+      };
+
+    models.push_back(loadModel(path, collect));
+  }
+
+  std::map<std::string, Region> regions;
+
+  for(auto& frame : frames)
+  {
+    if(!regions.count(frame.path))
+      regions[frame.path].pic = loadPicture(frame.path);
+  }
+
+  // the tallest first: it packs tighter
+  std::vector<Region*> sorted;
+
+  for(auto& pair : regions)
+    sorted.push_back(&pair.second);
+
+  auto byHeight = [] (const Region* a, const Region* b) { return a->pic.dim.y > b->pic.dim.y; };
+  std::stable_sort(sorted.begin(), sorted.end(), byHeight);
+
+  std::vector<SkylinePacker> packers;
+  std::vector<int> heights;
+
+  for(auto region : sorted)
+  {
+    for(int i = 0; i < (int)packers.size() && region->page < 0; ++i)
+    {
+      if(packers[i].insert(region->pic.dim, region->pos))
+        region->page = i;
+    }
+
+    if(region->page < 0)
+    {
+      packers.push_back(SkylinePacker(PageSize));
+      heights.push_back(0);
+
+      if(!packers.back().insert(region->pic.dim, region->pos))
+      {
+        char buffer[256];
+        throw Error(format(buffer, "Picture too big for the atlas: %dx%d", region->pic.dim.x, region->pic.dim.y));
+      }
+
+      region->page = (int)packers.size() - 1;
+    }
+
+    auto& height = heights[region->page];
+    height = std::max(height, region->pos.y + region->pic.dim.y);
+  }
+
+  BakedAtlasContent r;
+
+  for(auto height : heights)
+  {
+    BakedAtlasContent::Page page;
+    page.size = { PageSize.x, height };
+    page.pixels.resize(page.size.x * page.size.y * 4);
+    r.pages.push_back(std::move(page));
+  }
+
+  for(auto& pair : regions)
+  {
+    auto& region = pair.second;
+    auto& page = r.pages[region.page];
+
+    // upside down, like 'ITexture::upload' does
+    for(int y = 0; y < region.pic.dim.y; ++y)
+    {
+      auto src = region.pic.pixels.data() + (region.pic.dim.y - 1 - y) * region.pic.stride * 4;
+      auto dst = page.pixels.data() + ((region.pos.y + y) * page.size.x + region.pos.x) * 4;
+      memcpy(dst, src, region.pic.dim.x * 4);
+    }
+  }
+
+  for(int i = 0; i < (int)models.size(); ++i)
+  {
+    BakedAtlasContent::Model model;
+    model.path = modelPaths[i];
+
+    for(auto& action : models[i].actions)
+    {
+      std::vector<BakedFrame> bakedFrames;
+
+      for(auto frameIdx : action.textures)
+      {
+        auto& frame = frames[frameIdx];
+        auto& region = regions.at(frame.path);
+
+        Vec2f uv[2];
+        computeAtlasUV(r.pages[region.page].size, region.pos, region.pic.dim, frame.frect, uv);
+
+        BakedFrame f;
+        f.page = region.page;
+        f.uv[0] = uv[0].x;
+        f.uv[1] = uv[0].y;
+        f.uv[2] = uv[1].x;
+        f.uv[3] = uv[1].y;
+        bakedFrames.push_back(f);
+      }
+
+      model.actions.push_back(std::move(bakedFrames));
+    }
+
+    r.models.push_back(std::move(model));
+  }
+
+  fprintf(stderr, "Baked %d models, %d pictures, into %d pages\n", (int)models.size(), (int)regions.size(), (int)r.pages.size());
+
+  return r;
+}
+}
+
+int main(int argc, const char* argv[])
+{
+  if(argc < 2)
+  {
+    fprintf(stderr, "Usage: %s <atlas.bin> [models...]\n", argv[0]);
+    return 1;
+  }
+
+  try
+  {
+    std::vector<std::string> modelPaths(argv + 2, argv + argc);
+    auto data = serializeBakedAtlas(bake(modelPaths));
+    File::write(std::string(argv[1]), { data.data(), (int)data.size() });
+    return 0;
+  }
+  catch(const Error& e)
+  {
+    fprintf(stderr, "Fatal: %.*s\n", e.msg.len, e.msg.data);
+    return 1;
+  }
+}
+
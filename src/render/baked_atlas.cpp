@@ -0,0 +1,173 @@
+// Copyright (C) 2025 - Sebastien Alaiwan
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as
+// published by the Free Software Foundation, either version 3 of the
+// License, or (at your option) any later version.
+
+#include "baked_atlas.h"
+
+#include <cstring> // memcpy
+
+#include "base/error.h"
+
+namespace
+{
+template<typename T>
+Span<const T> getTable(Span<const uint8_t> data, uint32_t& offset, uint32_t count)
+{
+  if(count > (data.len - offset) / sizeof(T))
+    throw Error("Truncated baked atlas");
+
+  Span<const T> r((const T*)(data.data + offset), count);
+  offset += count * sizeof(T);
+  return r;
+}
+
+template<typename T>
+void append(std::vector<uint8_t>& dst, const T& value)
+{
+  auto p = (const uint8_t*)&value;
+  dst.insert(dst.end(), p, p + sizeof value);
+}
+}
+
+String BakedAtlas::path(const BakedModel& model) const
+{
+  return String(strings + model.pathOffset, model.pathLen);
+}
+
+const uint8_t* BakedAtlas::pixels(const BakedPage& page) const
+{
+  return data.data + page.pixelOffset;
+}
+
+BakedAtlas openBakedAtlas(Span<const uint8_t> data)
+{
+  BakedAtlasHeader header;
+
+  if(data.len < (int)sizeof header)
+    throw Error("Truncated baked atlas");
+
+  memcpy(&header, data.data, sizeof header);
+
+  if(header.magic != BakedAtlasMagic)
+    throw Error("Not a baked atlas");
+
+  if(header.version != BakedAtlasVersion)
+    throw Error("Unsupported baked atlas version");
+
+  BakedAtlas r;
+  r.data = data;
+
+  uint32_t offset = sizeof header;
+  r.pages = getTable<BakedPage>(data, offset, header.pageCount);
+  r.models = getTable<BakedModel>(data, offset, header.modelCount);
+  r.actions = getTable<BakedAction>(data, offset, header.actionCount);
+  r.frames = getTable<BakedFrame>(data, offset, header.frameCount);
+  r.strings = (const char*)getTable<char>(data, offset, header.stringSize).data;
+
+  for(auto& page : r.pages)
+  {
+    const uint64_t size = uint64_t(page.width) * page.height * 4;
+
+    if(page.width < 0 || page.height < 0 || page.pixelOffset + size > uint64_t(data.len))
+      throw Error("Corrupted baked atlas: page out of bounds");
+  }
+
+  for(auto& model : r.models)
+  {
+    if(uint64_t(model.pathOffset) + model.pathLen > header.stringSize)
+      throw Error("Corrupted baked atlas: model path out of bounds");
+
+    if(uint64_t(model.firstAction) + model.actionCount > header.actionCount)
+      throw Error("Corrupted baked atlas: model actions out of bounds");
+  }
+
+  for(auto& action : r.actions)
+  {
+    if(uint64_t(action.firstFrame) + action.frameCount > header.frameCount)
+      throw Error("Corrupted baked atlas: action frames out of bounds");
+  }
+
+  for(auto& frame : r.frames)
+  {
+    if(frame.page >= header.pageCount)
+      throw Error("Corrupted baked atlas: frame page out of bounds");
+  }
+
+  return r;
+}
+
+std::vector<uint8_t> serializeBakedAtlas(const BakedAtlasContent& content)
+{
+  std::vector<BakedModel> models;
+  std::vector<BakedAction> actions;
+  std::vector<BakedFrame> frames;
+  std::string strings;
+
+  for(auto& model : content.models)
+  {
+    BakedModel m;
+    m.pathOffset = strings.size();
+    m.pathLen = model.path.size();
+    m.firstAction = actions.size();
+    m.actionCount = model.actions.size();
+    models.push_back(m);
+
+    strings += model.path;
+
+    for(auto& action : model.actions)
+    {
+      actions.push_back({ (uint32_t)frames.size(), (uint32_t)action.size() });
+      frames.insert(frames.end(), action.begin(), action.end());
+    }
+  }
+
+  // keeps the pixels aligned
+  strings.resize((strings.size() + 3) / 4 * 4);
+
+  BakedAtlasHeader header {};
+  header.magic = BakedAtlasMagic;
+  header.version = BakedAtlasVersion;
+  header.pageCount = content.pages.size();
+  header.modelCount = models.size();
+  header.actionCount = actions.size();
+  header.frameCount = frames.size();
+  header.stringSize = strings.size();
+
+  uint32_t pixelOffset = sizeof header;
+  pixelOffset += content.pages.size() * sizeof(BakedPage);
+  pixelOffset += models.size() * sizeof(BakedModel);
+  pixelOffset += actions.size() * sizeof(BakedAction);
+  pixelOffset += frames.size() * sizeof(BakedFrame);
+  pixelOffset += strings.size();
+
+  std::vector<uint8_t> r;
+  append(r, header);
+
+  for(auto& page : content.pages)
+  {
+    if((int)page.pixels.size() != page.size.x * page.size.y * 4)
+      throw Error("Baked atlas page has the wrong pixel count");
+
+    append(r, BakedPage { page.size.x, page.size.y, pixelOffset });
+    pixelOffset += page.pixels.size();
+  }
+
+  for(auto& m : models)
+    append(r, m);
+
+  for(auto& a : actions)
+    append(r, a);
+
+  for(auto& f : frames)
+    append(r, f);
+
+  r.insert(r.end(), strings.begin(), strings.end());
+
+  for(auto& page : content.pages)
+    r.insert(r.end(), page.pixels.begin(), page.pixels.end());
+
+  return r;
+}
+
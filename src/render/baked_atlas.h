@@ -0,0 +1,98 @@
+// Copyright (C) 2025 - Sebastien Alaiwan
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as
+// published by the Free Software Foundation, either version 3 of the
+// License, or (at your option) any later version.
+
+// Texture atlas baked at build time (see bakeatlas.cpp): the atlas pages,
+// and the models whose pictures they contain.
+// At runtime, the tables are used in place, directly from the file contents.
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "base/geom.h"
+#include "base/span.h"
+#include "base/string.h"
+
+const uint32_t BakedAtlasMagic = 0x534C5441; // 'ATLS'
+const uint32_t BakedAtlasVersion = 1;
+
+// File layout: the header, then each table, then the strings, then the pixels.
+struct BakedAtlasHeader
+{
+  uint32_t magic;
+  uint32_t version;
+  uint32_t pageCount;
+  uint32_t modelCount;
+  uint32_t actionCount;
+  uint32_t frameCount;
+  uint32_t stringSize; // padded to 4 bytes
+};
+
+// RGBA8, the bottom row first: ready to be uploaded in one call
+struct BakedPage
+{
+  int32_t width, height;
+  uint32_t pixelOffset; // from the beginning of the file
+};
+
+struct BakedModel
+{
+  uint32_t pathOffset, pathLen; // in the strings
+  uint32_t firstAction, actionCount;
+};
+
+struct BakedAction
+{
+  uint32_t firstFrame, frameCount;
+};
+
+struct BakedFrame
+{
+  uint32_t page;
+  float uv[4]; // left, top, right, bottom (as computed by 'computeAtlasUV')
+};
+
+struct BakedAtlas
+{
+  Span<const BakedPage> pages;
+  Span<const BakedModel> models;
+  Span<const BakedAction> actions;
+  Span<const BakedFrame> frames;
+
+  String path(const BakedModel& model) const;
+  const uint8_t* pixels(const BakedPage& page) const;
+
+  Span<const uint8_t> data;
+  const char* strings = nullptr;
+};
+
+// Checks the header and the bounds of all the tables, then points into 'data',
+// which must outlive the result.
+BakedAtlas openBakedAtlas(Span<const uint8_t> data);
+
+// Content of a baked atlas, as built by the tool
+struct BakedAtlasContent
+{
+  struct Page
+  {
+    Vec2i size;
+    std::vector<uint8_t> pixels;
+  };
+
+  struct Model
+  {
+    std::string path;
+    std::vector<std::vector<BakedFrame>> actions;
+  };
+
+  std::vector<Page> pages;
+  std::vector<Model> models;
+};
+
+std::vector<uint8_t> serializeBakedAtlas(const BakedAtlasContent& content);
+
@@ -0,0 +1,95 @@
+// Copyright (C) 2025 - Sebastien Alaiwan
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as
+// published by the Free Software Foundation, either version 3 of the
+// License, or (at your option) any later version.
+
+// Benchmark: sorting the renderer's queued quads, with the comparison-based
+// heapsort ('my::sort') and with the radix sort on packed keys.
+//
+// Usage: benchsort.exe [counts...] (default: 1000 10000 30000)
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib> // atoi
+#include <vector>
+
+#include "base/my_algorithm.h"
+
+namespace
+{
+// same size as the renderer's queued quads
+struct Quad
+{
+  uint64_t key;
+  int zOrder;
+  int tile;
+  float instance[12];
+};
+
+int us(std::chrono::steady_clock::duration d)
+{
+  return (int)std::chrono::duration_cast<std::chrono::microseconds>(d).count();
+}
+
+void bench(int count)
+{
+  uint32_t seed = 1234;
+  auto random = [&] () { seed = seed * 1103515245 + 12345; return (int)(seed >> 16); };
+
+  std::vector<Quad> quads(count);
+
+  for(int i = 0; i < count; ++i)
+  {
+    auto& q = quads[i];
+    q.zOrder = random() % 32;
+    q.tile = random() % 4;
+    q.key = uint64_t(q.zOrder + 0x8000) << 48 | uint64_t(q.tile) << 32 | i;
+  }
+
+  auto const t0 = std::chrono::steady_clock::now();
+
+  {
+    auto copy = quads;
+    auto byPriority = [&] (Quad const& a, Quad const& b)
+      {
+        if(a.zOrder != b.zOrder)
+          return a.zOrder < b.zOrder;
+
+        return a.tile < b.tile;
+      };
+    my::sort(Span<Quad>(copy), byPriority);
+  }
+
+  auto const t1 = std::chrono::steady_clock::now();
+
+  std::vector<my::KeyIndex> order(count), tmp(count);
+
+  {
+    for(int i = 0; i < count; ++i)
+      order[i] = { quads[i].key, i };
+
+    my::radixSort(Span<my::KeyIndex>(order), Span<my::KeyIndex>(tmp));
+  }
+
+  auto const t2 = std::chrono::steady_clock::now();
+
+  printf("%d quads: heapsort %d us, radix sort %d us\n", count, us(t1 - t0), us(t2 - t1));
+}
+}
+
+int main(int argc, char* argv[])
+{
+  std::vector<int> counts;
+
+  for(int i = 1; i < argc; ++i)
+    counts.push_back(atoi(argv[i]));
+
+  if(counts.empty())
+    counts = { 1000, 10000, 30000 };
+
+  for(auto count : counts)
+    bench(count);
+
+  return 0;
+}
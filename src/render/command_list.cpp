@@ -0,0 +1,231 @@
+// Copyright (C) 2023 - Sebastien Alaiwan
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as
+// published by the Free Software Foundation, either version 3 of the
+// License, or (at your option) any later version.
+
+#include "command_list.h"
+
+#include <cstring> // memcpy
+
+#include "base/error.h"
+
+namespace
+{
+struct CommandReader
+{
+  Span<const uint8_t> data;
+  int pos = 0;
+
+  template<typename T>
+  T read()
+  {
+    T r;
+    memcpy(&r, get(sizeof r), sizeof r);
+    return r;
+  }
+
+  String readString()
+  {
+    auto len = read<int>();
+
+    if(len < 0)
+      throw Error("Corrupt command list");
+
+    // followed by a terminating zero
+    if(len >= data.len - pos)
+      throw Error("Truncated command list");
+
+    auto s = (const char*)get(len + 1);
+    return String(s, len);
+  }
+
+  // lists loaded from files may be truncated
+  const uint8_t* get(int size)
+  {
+    if(size < 0 || size > data.len - pos)
+      throw Error("Truncated command list");
+
+    auto r = data.data + pos;
+    pos += size;
+    return r;
+  }
+};
+}
+
+void CommandList::loadModel(int id, String imagePath)
+{
+  push(Command::LoadModel, id);
+  pushString(imagePath);
+}
+
+void CommandList::setCamera(Vec2f pos)
+{
+  push(Command::SetCamera, pos);
+}
+
+void CommandList::setAmbientLight(float ambientLight)
+{
+  push(Command::SetAmbientLight, ambientLight);
+}
+
+void CommandList::beginDraw()
+{
+  data.push_back((uint8_t)Command::BeginDraw);
+}
+
+void CommandList::drawSprite(const RenderSprite& sprite)
+{
+  push(Command::DrawSprite, sprite);
+}
+
+void CommandList::drawText(const RenderText& text)
+{
+  push(Command::DrawText, text);
+  pushString(text.text);
+}
+
+void CommandList::drawCircle(const RenderCircle& circle)
+{
+  push(Command::DrawCircle, circle);
+}
+
+void CommandList::drawLine(const RenderLine& line)
+{
+  push(Command::DrawLine, line);
+}
+
+void CommandList::drawRect(const RenderRect& rect)
+{
+  push(Command::DrawRect, rect);
+}
+
+void CommandList::loadTileLayer(const RenderTileLayer& layer)
+{
+  push(Command::LoadTileLayer, layer);
+  pushRaw(layer.tiles.data, layer.tiles.len * sizeof(int));
+}
+
+void CommandList::drawTileLayer()
+{
+  data.push_back((uint8_t)Command::DrawTileLayer);
+}
+
+// strings are copied into the list, with a NUL terminator
+void CommandList::pushString(String s)
+{
+  pushRaw(&s.len, sizeof s.len);
+  pushRaw(s.data, s.len);
+  data.push_back(0);
+}
+
+void CommandList::pushRaw(const void* src, int size)
+{
+  auto p = (const uint8_t*)src;
+  data.insert(data.end(), p, p + size);
+}
+
+void executeCommands(Span<const uint8_t> commands, IRenderer* renderer, bool draw)
+{
+  CommandReader reader { commands };
+
+  while(reader.pos < commands.len)
+  {
+    switch((Command)reader.read<uint8_t>())
+    {
+    case Command::LoadModel:
+      {
+        auto id = reader.read<int>();
+        auto path = reader.readString();
+        renderer->loadModel(id, path);
+        break;
+      }
+    case Command::SetCamera:
+      renderer->setCamera(reader.read<Vec2f>());
+      break;
+    case Command::SetAmbientLight:
+      renderer->setAmbientLight(reader.read<float>());
+      break;
+    case Command::BeginDraw:
+      if(draw)
+        renderer->beginDraw();
+      break;
+    case Command::DrawSprite:
+      {
+        auto sprite = reader.read<RenderSprite>();
+
+        if(draw)
+          renderer->drawSprite(sprite);
+
+        break;
+      }
+    case Command::DrawText:
+      {
+        auto text = reader.read<RenderText>();
+        text.text = reader.readString();
+
+        if(draw)
+          renderer->drawText(text);
+
+        break;
+      }
+    case Command::DrawCircle:
+      {
+        auto circle = reader.read<RenderCircle>();
+
+        if(draw)
+          renderer->drawCircle(circle);
+
+        break;
+      }
+    case Command::DrawLine:
+      {
+        auto line = reader.read<RenderLine>();
+
+        if(draw)
+          renderer->drawLine(line);
+
+        break;
+      }
+    case Command::DrawRect:
+      {
+        auto rect = reader.read<RenderRect>();
+
+        if(draw)
+          renderer->drawRect(rect);
+
+        break;
+      }
+    case Command::LoadTileLayer:
+      {
+        auto layer = reader.read<RenderTileLayer>();
+
+        if(layer.tiles.len < 0 || layer.size.x < 0 || layer.size.y < 0)
+          throw Error("Corrupt command list");
+
+        // the renderer reads one tile per cell
+        if((int64_t)layer.size.x * layer.size.y != layer.tiles.len)
+          throw Error("Corrupt command list");
+
+        // compared without multiplying, which could overflow
+        if(layer.tiles.len > (commands.len - reader.pos) / (int)sizeof(int))
+          throw Error("Truncated command list");
+
+        // copied out, as the list gives no alignment guarantee
+        std::vector<int> tiles(layer.tiles.len);
+        memcpy(tiles.data(), reader.get(tiles.size() * sizeof(int)), tiles.size() * sizeof(int));
+
+        layer.tiles = tiles;
+        renderer->loadTileLayer(layer);
+        break;
+      }
+    case Command::DrawTileLayer:
+      if(draw)
+        renderer->drawTileLayer();
+      break;
+    default:
+      throw Error("Unknown command in command list");
+    }
+  }
+}
+
@@ -0,0 +1,67 @@
+// Copyright (C) 2023 - Sebastien Alaiwan
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as
+// published by the Free Software Foundation, either version 3 of the
+// License, or (at your option) any later version.
+
+// Renderer calls, recorded into a flat byte buffer, to be replayed later
+// on another renderer (see threaded_renderer.cpp and render_log.h).
+// Payloads are the raw render structs: a list can only be replayed by the
+// build which recorded it.
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "base/renderer.h"
+#include "base/span.h"
+
+enum class Command : uint8_t
+{
+  LoadModel,
+  SetCamera,
+  SetAmbientLight,
+  BeginDraw,
+  DrawSprite,
+  DrawText,
+  DrawCircle,
+  DrawLine,
+  DrawRect,
+  LoadTileLayer,
+  DrawTileLayer,
+};
+
+struct CommandList
+{
+  std::vector<uint8_t> data;
+
+  void loadModel(int id, String imagePath);
+  void setCamera(Vec2f pos);
+  void setAmbientLight(float ambientLight);
+  void beginDraw();
+  void drawSprite(const RenderSprite& sprite);
+  void drawText(const RenderText& text);
+  void drawCircle(const RenderCircle& circle);
+  void drawLine(const RenderLine& line);
+  void drawRect(const RenderRect& rect);
+  void loadTileLayer(const RenderTileLayer& layer);
+  void drawTileLayer();
+
+private:
+  template<typename T>
+  void push(Command cmd, const T& payload)
+  {
+    data.push_back((uint8_t)cmd);
+    pushRaw(&payload, sizeof payload);
+  }
+
+  void pushString(String s);
+  void pushRaw(const void* src, int size);
+};
+
+// Calls the recorded functions on 'renderer', in order.
+// If 'draw' is false, only the commands changing the renderer state are
+// executed: the draw calls, and 'beginDraw', are skipped.
+void executeCommands(Span<const uint8_t> commands, IRenderer* renderer, bool draw = true);
+
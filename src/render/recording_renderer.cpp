@@ -0,0 +1,144 @@
+// Copyright (C) 2025 - Sebastien Alaiwan
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as
+// published by the Free Software Foundation, either version 3 of the
+// License, or (at your option) any later version.
+
+// Forwards the calls to another renderer, and records them into a render log
+// (see render_log.h). Each frame is written to the file as soon as it ends,
+// so long sessions don't accumulate in memory.
+
+#include <cstdio>
+#include <memory>
+#include <string>
+
+#include "base/error.h"
+#include "base/logger.h"
+#include "base/renderer.h"
+#include "command_list.h"
+#include "render_log.h"
+
+namespace
+{
+struct RecordingRenderer : IRenderer
+{
+  RecordingRenderer(IRenderer* renderer, String path, Vec2i resolution)
+    : m_renderer(renderer)
+    , m_path(path.data, path.len)
+  {
+    m_fp = fopen(m_path.c_str(), "wb");
+
+    if(!m_fp)
+      throw Error("Can't open file '" + m_path + "' for writing");
+
+    RenderLogHeader header {};
+    header.magic = RenderLogMagic;
+    header.version = RenderLogVersion;
+    header.layout = renderLogLayout();
+    header.width = resolution.x;
+    header.height = resolution.y;
+    fwrite(&header, 1, sizeof header, m_fp);
+
+    logMsg("Recording render log to '%s'", m_path.c_str());
+  }
+
+  ~RecordingRenderer()
+  {
+    fclose(m_fp);
+    logMsg("Render log saved to '%s' (%d frames)", m_path.c_str(), m_frameCount);
+  }
+
+  void loadModel(int id, String imagePath) override
+  {
+    m_frame.loadModel(id, imagePath);
+    m_renderer->loadModel(id, imagePath);
+  }
+
+  void setCamera(Vec2f pos) override
+  {
+    m_frame.setCamera(pos);
+    m_renderer->setCamera(pos);
+  }
+
+  void setAmbientLight(float ambientLight) override
+  {
+    m_frame.setAmbientLight(ambientLight);
+    m_renderer->setAmbientLight(ambientLight);
+  }
+
+  void beginDraw() override
+  {
+    m_frame.beginDraw();
+    m_renderer->beginDraw();
+  }
+
+  void endDraw() override
+  {
+    m_renderer->endDraw();
+
+    const auto size = (uint32_t)m_frame.data.size();
+    fwrite(&size, 1, sizeof size, m_fp);
+    fwrite(m_frame.data.data(), 1, m_frame.data.size(), m_fp);
+
+    m_frame.data.clear();
+    ++m_frameCount;
+  }
+
+  void drawSprite(const RenderSprite& sprite) override
+  {
+    m_frame.drawSprite(sprite);
+    m_renderer->drawSprite(sprite);
+  }
+
+  void drawText(const RenderText& text) override
+  {
+    m_frame.drawText(text);
+    m_renderer->drawText(text);
+  }
+
+  void drawCircle(const RenderCircle& circle) override
+  {
+    m_frame.drawCircle(circle);
+    m_renderer->drawCircle(circle);
+  }
+
+  void drawLine(const RenderLine& line) override
+  {
+    m_frame.drawLine(line);
+    m_renderer->drawLine(line);
+  }
+
+  void drawRect(const RenderRect& rect) override
+  {
+    m_frame.drawRect(rect);
+    m_renderer->drawRect(rect);
+  }
+
+  void loadTileLayer(const RenderTileLayer& layer) override
+  {
+    m_frame.loadTileLayer(layer);
+    m_renderer->loadTileLayer(layer);
+  }
+
+  void drawTileLayer() override
+  {
+    m_frame.drawTileLayer();
+    m_renderer->drawTileLayer();
+  }
+
+private:
+  std::unique_ptr<IRenderer> m_renderer;
+  const std::string m_path;
+  FILE* m_fp = nullptr;
+  CommandList m_frame; // the calls since the last 'endDraw'
+  int m_frameCount = 0;
+};
+}
+
+// Takes ownership of 'renderer'.
+// 'resolution' is the internal resolution 'renderer' was created with.
+IRenderer* createRecordingRenderer(IRenderer* renderer, String path, Vec2i resolution)
+{
+  return new RecordingRenderer(renderer, path, resolution);
+}
+
@@ -0,0 +1,76 @@
+// Copyright (C) 2025 - Sebastien Alaiwan
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as
+// published by the Free Software Foundation, either version 3 of the
+// License, or (at your option) any later version.
+
+#include "render_log.h"
+
+#include <cstring> // memcpy
+
+#include "base/error.h"
+#include "base/renderer.h"
+
+uint32_t renderLogLayout()
+{
+  const size_t sizes[] =
+  {
+    sizeof(RenderSprite),
+    sizeof(RenderText),
+    sizeof(RenderCircle),
+    sizeof(RenderLine),
+    sizeof(RenderRect),
+    sizeof(RenderTileLayer),
+  };
+
+  uint32_t r = 0;
+
+  for(auto size : sizes)
+    r = r * 31 + size;
+
+  return r;
+}
+
+RenderLog openRenderLog(Span<const uint8_t> data)
+{
+  RenderLogHeader header;
+
+  if(data.len < (int)sizeof header)
+    throw Error("Truncated render log");
+
+  memcpy(&header, data.data, sizeof header);
+
+  if(header.magic != RenderLogMagic)
+    throw Error("Not a render log");
+
+  if(header.version != RenderLogVersion)
+    throw Error("Unsupported render log version");
+
+  if(header.layout != renderLogLayout())
+    throw Error("Render log recorded by an incompatible build");
+
+  RenderLog r;
+  r.resolution = { header.width, header.height };
+
+  data += sizeof header;
+
+  while(data.len > 0)
+  {
+    uint32_t size;
+
+    if(data.len < (int)sizeof size)
+      throw Error("Truncated render log");
+
+    memcpy(&size, data.data, sizeof size);
+    data += sizeof size;
+
+    if(size > uint32_t(data.len))
+      throw Error("Truncated render log");
+
+    r.frames.push_back({ data.data, int(size) });
+    data += size;
+  }
+
+  return r;
+}
+
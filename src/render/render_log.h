@@ -0,0 +1,45 @@
+// Copyright (C) 2025 - Sebastien Alaiwan
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as
+// published by the Free Software Foundation, either version 3 of the
+// License, or (at your option) any later version.
+
+// Render log: the renderer calls of a game session, frame by frame.
+// Written by the recording renderer ('--record-render'), replayed on a real
+// renderer by the 'replayrender' tool, to benchmark the renderer on actual
+// game frames, without running the gameplay.
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "base/geom.h"
+#include "base/span.h"
+
+const uint32_t RenderLogMagic = 0x474F4C52; // 'RLOG'
+const uint32_t RenderLogVersion = 2;
+
+// File layout: the header, then for each frame, its size as an uint32_t,
+// then its commands (see command_list.h), up to 'endDraw'.
+struct RenderLogHeader
+{
+  uint32_t magic;
+  uint32_t version;
+  uint32_t layout; // see 'renderLogLayout'
+  int32_t width, height; // internal resolution of the recorded renderer
+};
+
+// Changes when the render structs do: the commands store them as is.
+uint32_t renderLogLayout();
+
+struct RenderLog
+{
+  Vec2i resolution;
+  std::vector<Span<const uint8_t>> frames;
+};
+
+// Checks the header and the frame sizes, then points into 'data',
+// which must outlive the result.
+RenderLog openRenderLog(Span<const uint8_t> data);
+
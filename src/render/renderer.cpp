@@ -4,16 +4,18 @@
 // published by the Free Software Foundation, either version 3 of the
 // License, or (at your option) any later version.
 
-#include <array>
+#include <algorithm> // sort
 #include <cmath>
+#include <cstring> // memcmp
 #include <unordered_map>
 #include <vector>
 
-#include "base/box.h"
+#include "atlas.h"
+#include "baked_atlas.h"
 #include "base/error.h"
 #include "base/geom.h"
 #include "base/logger.h"
-#include "base/my_algorithm.h" // sort
+#include "base/my_algorithm.h" // sort, radixSort
 #include "base/renderer.h"
 #include "base/scene.h"
 #include "base/span.h"
@@ -26,17 +28,53 @@
 #include "misc/util.h"
 #include "model.h"
 #include "picture.h"
+#include "sprite_batch.h"
 
 namespace
 {
 Gauge ggVboCap("VBO cap");
 Gauge ggSpriteCount("sprites");
 Gauge ggBatchCount("batches");
+Gauge ggInstanceBytes("instance bytes");
+Gauge ggTileChunks("tile chunks");
+Gauge ggAtlasPages("atlas pages");
+Gauge ggAtlasOccupancy("atlas occupancy %");
+Gauge ggAtlasFragmentation("atlas fragmentation %");
+Gauge ggTextsRebuilt("texts rebuilt");
 
 const int MAX_QUADS = 32678;
 const auto TILE_SIZE = 16.0f;
-const float SCALE = 0.1;
 const Vec2i AtlasSize = { 2048, 2048 };
+const int MAX_ATLAS_PAGES = 4;
+const String BakedAtlasPath = "res/atlas.bin"; // see bakeatlas.cpp
+const int TILE_CHUNK_SIZE = 16; // in tiles, about the size of the screen
+const int MAX_TILEMAP_SIZE = 2048; // in tiles, or distinct tiles. Minimum texture size guaranteed by GLES3
+
+// zOrder (16 bits) | texture (16 bits) | submission index (32 bits)
+uint64_t makeSortKey(int zOrder, int texture, int index)
+{
+  const uint64_t z = ::clamp(zOrder + 0x8000, 0, 0xFFFF);
+  const uint64_t t = texture & 0xFFFF;
+  return z << 48 | t << 32 | (uint32_t)index;
+}
+
+// FNV-1a, over the characters and the position
+uint64_t hashText(const RenderText& text)
+{
+  uint64_t r = 0xcbf29ce484222325;
+
+  auto hash = [&] (const void* data, int size)
+    {
+      auto p = (const uint8_t*)data;
+
+      for(int i = 0; i < size; ++i)
+        r = (r ^ p[i]) * 0x100000001b3;
+    };
+
+  hash(text.text.data, text.text.len);
+  hash(&text.pos, sizeof text.pos);
+  return r;
+}
 
 Vec2f multiplyMatrix(const Matrix3f& mat, float v0, float v1, float v2)
 {
@@ -52,22 +90,69 @@ struct Camera
   float angle = 0;
 };
 
-// VBO format
+// Positions are stored on 16 bits, covering [-PositionRange;+PositionRange]
+// in clip space. Must match the vertex shaders.
+const float PositionRange = 16;
+
+// VBO format: the unit quad
 struct Vertex
 {
-  float x, y, u, v;
-  float r = 1, g = 1, b = 1, a = 1;
+  int16_t x, y; // clip space, divided by 'PositionRange'
+  int16_t u, v; // normalized to [-1;1]
+  uint8_t r, g, b, a;
+};
+
+int16_t toSnorm16(float val)
+{
+  return (int16_t)std::lround(::clamp(val, -1.0f, 1.0f) * 32767);
+}
+
+uint8_t toUnorm8(float val)
+{
+  return (uint8_t)std::lround(::clamp(val, 0.0f, 1.0f) * 255);
+}
+
+Vertex makeVertex(Vec2f pos, Vec2f uv, RenderColor color = { 1, 1, 1, 1 })
+{
+  Vertex r;
+  r.x = toSnorm16(pos.x / PositionRange);
+  r.y = toSnorm16(pos.y / PositionRange);
+  r.u = toSnorm16(uv.x);
+  r.v = toSnorm16(uv.y);
+  r.r = toUnorm8(color.r);
+  r.g = toUnorm8(color.g);
+  r.b = toUnorm8(color.b);
+  r.a = toUnorm8(color.a);
+  return r;
+}
+
+enum class ShapeKind
+{
+  Line,
+  Circle,
+  Rect,
+};
+
+// VBO format, instanced lines, circles and rects: one per shape.
+// They are drawn as single quads, by a signed distance field shader.
+struct ShapeInstance
+{
+  float x0, y0; // view space. Line: first end. Circle: center. Rect: a corner
+  float x1, y1; // view space. Line: second end. Circle: radius, 0. Rect: the opposite corner
+  float thickness;
+  float kind; // a ShapeKind
+  float color[4];
 };
 
 const Vertex quadVertices[] =
 {
-  { -1, -1, 0, 0 },
-  { +1, -1, 1, 0 },
-  { +1, +1, 1, 1 },
+  makeVertex({ -1, -1 }, { 0, 0 }),
+  makeVertex({ +1, -1 }, { 1, 0 }),
+  makeVertex({ +1, +1 }, { 1, 1 }),
 
-  { -1, -1, 0, 0 },
-  { +1, +1, 1, 1 },
-  { -1, +1, 0, 1 },
+  makeVertex({ -1, -1 }, { 0, 0 }),
+  makeVertex({ +1, +1 }, { 1, 1 }),
+  makeVertex({ -1, +1 }, { 0, 1 }),
 };
 
 struct Renderer : IRenderer
@@ -77,45 +162,62 @@ struct Renderer : IRenderer
     , m_internalResolution(internalResolution)
   {
     m_quadShader = backend->createGpuProgram("standard", false);
-    m_lineShader = backend->createGpuProgram("line", false);
-    m_batchVbo = backend->createVertexBuffer();
+    m_spriteShader = backend->createGpuProgram("sprite", false);
+    m_shapeShader = backend->createGpuProgram("shape", false);
+
+    // optional: without it, tile layers are drawn by chunks
+    try
+    {
+      m_tilemapShader = backend->createGpuProgram("tilemap", false);
+      backend->setSamplerUnit(m_tilemapShader.get(), "TileIndices", 1);
+      backend->setSamplerUnit(m_tilemapShader.get(), "TilePalette", 2);
+    }
+    catch(const Error& e)
+    {
+      logMsg("[renderer] no tilemap program: %.*s. Falling back on tile chunks", e.message().len, e.message().data);
+      m_tilemapShader.reset();
+    }
+
+    m_instanceVbo = backend->createVertexBuffer();
     m_fb = backend->createFrameBuffer(m_internalResolution, false);
 
     m_quadVbo = backend->createVertexBuffer();
     m_quadVbo->upload(quadVertices, sizeof quadVertices);
 
-    m_atlasTexture = backend->createTexture();
-    m_atlasTexture->create(AtlasSize);
+    // pages are referenced while new ones get created
+    m_atlasPages.reserve(MAX_ATLAS_PAGES);
+
+    if(File::exists(BakedAtlasPath))
+      loadBakedAtlas();
 
     loadModel(-1, "res/font.model");
   }
 
   void loadModel(int id, String path) override
   {
-    auto loadTexFunc = [&] (String path, Rect2f frect) { return loadTexture(path, frect); };
-    m_Models[id] = ::loadModel(path, loadTexFunc);
-  }
-
-  void setCamera(Vec2f pos, bool teleport) override
-  {
-    auto cam = Camera{ pos, 0 };
+    Model model;
 
-    if(!m_cameraValid || teleport)
+    if(!loadBakedModel(path, model))
     {
-      m_camera = cam;
-      m_cameraValid = true;
+      auto loadTexFunc = [&] (String path, Rect2f frect) { return loadTexture(path, frect); };
+      model = ::loadModel(path, loadTexFunc);
     }
 
-    // avoid big camera jumps
-    {
-      auto delta = m_camera.pos - pos;
+    // released after the new one is loaded: the textures they share stay in the atlas
+    auto it = m_Models.find(id);
 
-      if(abs(delta.x) > 2 || abs(delta.y) > 2)
-        m_camera = cam;
-    }
+    if(it != m_Models.end())
+      releaseModel(it->second);
+
+    m_Models[id] = std::move(model);
+
+    // the glyphs may have moved in the atlas, or changed
+    m_texts.clear();
+  }
 
-    m_camera.pos = lerp(m_camera.pos, cam.pos, 0.3f);
-    m_camera.angle = cam.angle;
+  void setCamera(Vec2f pos) override
+  {
+    m_camera = Camera{ pos, 0 };
   }
 
   void setAmbientLight(float ambientLight) override
@@ -133,6 +235,12 @@ struct Renderer : IRenderer
     float fragOffset[4];
   };
 
+  struct SpriteUniformBlock
+  {
+    float viewTransform[4]; // xy: offset, in view space. zw: scale, view space to clip space
+    float lightOffset[4]; // added to the per-instance light
+  };
+
   void endDraw() override
   {
     // draw to internal framebuffer, with fixed resolution
@@ -148,8 +256,8 @@ struct Renderer : IRenderer
     backend->useGpuProgram(m_quadShader.get());
     backend->useVertexBuffer(m_quadVbo.get());
     m_fb->getColorTexture()->bind(0);
-    backend->enableVertexAttribute(0 /* positionLoc */, 2, sizeof(Vertex), offsetof(Vertex, x));
-    backend->enableVertexAttribute(1 /* uvLoc       */, 2, sizeof(Vertex), offsetof(Vertex, u));
+    backend->enableVertexAttribute(0 /* positionLoc */, 2, sizeof(Vertex), offsetof(Vertex, x), AttributeType::Short, true);
+    backend->enableVertexAttribute(1 /* uvLoc       */, 2, sizeof(Vertex), offsetof(Vertex, u), AttributeType::Short, true);
     MyUniformBlock block {};
     backend->setUniformBlock(&block, sizeof block);
     backend->draw(6);
@@ -160,149 +268,82 @@ struct Renderer : IRenderer
   void processCommands()
   {
     batchCount = 0;
+    instanceBytes = 0;
 
-    auto byPriority = [&] (Quad const& a, Quad const& b)
-      {
-        if(a.zOrder != b.zOrder)
-          return a.zOrder < b.zOrder;
+    // move all the sprites to view space at once
+    const int worldCount = m_worldSprites.size();
+    m_spriteInstances.resize(worldCount + m_screenSprites.size());
+    generateSpriteInstances(m_worldSprites, getViewMatrix(m_camera), m_camera.angle, m_spriteInstances.data());
+    generateSpriteInstances(m_screenSprites, getViewMatrix(Camera()), 0, m_spriteInstances.data() + worldCount);
 
-        if(m_tiles[a.tile].texture != m_tiles[b.tile].texture)
-          return m_tiles[a.tile].texture < m_tiles[b.tile].texture;
+    // sort the visible quads by key, only the (key, index) pairs get moved
+    m_quadOrder.clear();
 
-        if(a.light != b.light)
-          return a.light < b.light;
+    for(int i = 0; i < (int)m_quads.size(); ++i)
+    {
+      auto& quad = m_quads[i];
 
-        return true;
-      };
+      // from now on, an index into 'm_spriteInstances'
+      if(quad.screenRefFrame)
+        quad.instance += worldCount;
 
-    my::sort<Quad>(m_quads, byPriority);
+      if(isVisible(m_spriteInstances[quad.instance]))
+        m_quadOrder.push_back({ quad.key, i });
+    }
 
-    auto linesByZ = [] (const RenderLine& a, const RenderLine& b)
+    m_quadOrderTmp.resize(m_quadOrder.size());
+    my::radixSort(m_quadOrder, m_quadOrderTmp);
+
+    auto shapesByZ = [] (const Shape& a, const Shape& b)
       {
         return a.zOrder < b.zOrder;
       };
 
-    my::sort<RenderLine>(m_lines, linesByZ);
+    my::sort<Shape>(m_shapes, shapesByZ);
 
-    vboData.clear();
+    instances.clear();
+    shapeInstances.clear();
 
     ITexture* currTexture = nullptr;
-    std::array<float, 3> currLight {};
-    currLight[0] = 0.0f / 0.0f;
     IGpuProgram* currShader = nullptr;
 
-    backend->useVertexBuffer(m_batchVbo.get());
-
-    Span<RenderLine> lines(m_lines);
-    Span<RenderCircle> circles(m_circles);
-    Span<Quad> quads(m_quads);
+    Span<Shape> shapes(m_shapes);
+    Span<my::KeyIndex> quads(m_quadOrder);
 
-    const auto cameraTransform = getCameraMatrix(m_camera);
-    const auto identity = translate({});
-
-    auto addOneLine = [&] (const RenderLine& line)
+    auto addOneShape = [&] (const Shape& shape)
       {
-        if(currShader != m_lineShader.get())
+        if(currShader != m_shapeShader.get())
         {
           flushBatch();
 
-          backend->useGpuProgram(m_lineShader.get());
-          backend->enableVertexAttribute(0 /* positionLoc */, 2, sizeof(Vertex), offsetof(Vertex, x));
-          backend->enableVertexAttribute(1 /* uv          */, 2, sizeof(Vertex), offsetof(Vertex, u));
-          backend->enableVertexAttribute(2 /* color       */, 4, sizeof(Vertex), offsetof(Vertex, r));
-
-          currShader = m_lineShader.get();
-        }
-
-        auto const transform = identity;
-
-        auto const a = multiplyMatrix(transform, line.a.x, line.a.y, 1);
-        auto const b = multiplyMatrix(transform, line.b.x, line.b.y, 1);
-
-        auto const n = normalize(b - a);
-        auto const t = Vec2f(-n.y, n.x);
-
-        auto const p0 = a + t * line.thicknessMax * SCALE;
-        auto const p1 = a - t * line.thicknessMax * SCALE;
-        auto const p2 = b - t * line.thicknessMax * SCALE;
-        auto const p3 = b + t * line.thicknessMax * SCALE;
-
-        const auto u = line.thicknessMin;
-
-        vboData.push_back(Vertex{ p0.x, p0.y, -u, 0, line.color.r, line.color.g, line.color.b, line.color.a });
-        vboData.push_back(Vertex{ p1.x, p1.y, +u, 0, line.color.r, line.color.g, line.color.b, line.color.a });
-        vboData.push_back(Vertex{ p2.x, p2.y, +u, 0, line.color.r, line.color.g, line.color.b, line.color.a });
-
-        vboData.push_back(Vertex{ p0.x, p0.y, -u, 0, line.color.r, line.color.g, line.color.b, line.color.a });
-        vboData.push_back(Vertex{ p2.x, p2.y, +u, 0, line.color.r, line.color.g, line.color.b, line.color.a });
-        vboData.push_back(Vertex{ p3.x, p3.y, -u, 0, line.color.r, line.color.g, line.color.b, line.color.a });
-      };
+          backend->useGpuProgram(m_shapeShader.get());
 
-    auto addOneCircle = [&] (const RenderCircle& circle)
-      {
-        if(currShader != m_lineShader.get())
-        {
-          flushBatch();
-
-          backend->useGpuProgram(m_lineShader.get());
-          backend->enableVertexAttribute(0 /* positionLoc */, 2, sizeof(Vertex), offsetof(Vertex, x));
-          backend->enableVertexAttribute(1 /* uv          */, 2, sizeof(Vertex), offsetof(Vertex, u));
-          backend->enableVertexAttribute(2 /* color       */, 4, sizeof(Vertex), offsetof(Vertex, r));
+          const auto viewScale = getViewScale();
+          SpriteUniformBlock block { { 0, 0, viewScale.x, viewScale.y }, {} };
+          backend->setUniformBlock(&block, sizeof block);
 
-          currShader = m_lineShader.get();
+          currShader = m_shapeShader.get();
         }
 
-        auto transform = circle.useWorldRefFrame ? cameraTransform : identity;
-        const int N = 48;
-
-        for(int i = 0; i < N; ++i)
-        {
-          float angle0 = (i + 0) * 2 * PI / N;
-          float angle1 = (i + 1) * 2 * PI / N;
-
-          const float cos0 = cos(angle0);
-          const float sin0 = sin(angle0);
-          const float cos1 = cos(angle1);
-          const float sin1 = sin(angle1);
-
-          const float thickness = 1.0 * SCALE;
-
-          const float innerRadius = circle.radius - thickness * 0.5;
-          const float outerRadius = circle.radius + thickness * 0.5;
-
-          Vec2f p0 = circle.pos + Vec2f(cos0, sin0) * innerRadius;
-          Vec2f p1 = circle.pos + Vec2f(cos0, sin0) * outerRadius;
-          Vec2f p2 = circle.pos + Vec2f(cos1, sin1) * outerRadius;
-          Vec2f p3 = circle.pos + Vec2f(cos1, sin1) * innerRadius;
-
-          p0 = multiplyMatrix(transform, p0.x, p0.y, 1);
-          p1 = multiplyMatrix(transform, p1.x, p1.y, 1);
-          p2 = multiplyMatrix(transform, p2.x, p2.y, 1);
-          p3 = multiplyMatrix(transform, p3.x, p3.y, 1);
-
-          const auto u = 1;
-
-          vboData.push_back(Vertex{ p0.x, p0.y, -u, 0, circle.color.r, circle.color.g, circle.color.b, circle.color.a });
-          vboData.push_back(Vertex{ p1.x, p1.y, +u, 0, circle.color.r, circle.color.g, circle.color.b, circle.color.a });
-          vboData.push_back(Vertex{ p2.x, p2.y, +u, 0, circle.color.r, circle.color.g, circle.color.b, circle.color.a });
+        if((int)shapeInstances.size() >= MAX_QUADS)
+          flushBatch();
 
-          vboData.push_back(Vertex{ p0.x, p0.y, -u, 0, circle.color.r, circle.color.g, circle.color.b, circle.color.a });
-          vboData.push_back(Vertex{ p2.x, p2.y, +u, 0, circle.color.r, circle.color.g, circle.color.b, circle.color.a });
-          vboData.push_back(Vertex{ p3.x, p3.y, -u, 0, circle.color.r, circle.color.g, circle.color.b, circle.color.a });
-        }
+        shapeInstances.push_back(shape.instance);
       };
 
     auto addOneQuad = [&] (const Quad& quad)
       {
-        if(currShader != m_quadShader.get())
+        if(currShader != m_spriteShader.get())
         {
           flushBatch();
 
-          backend->useGpuProgram(m_quadShader.get());
-          backend->enableVertexAttribute(0 /* positionLoc */, 2, sizeof(Vertex), offsetof(Vertex, x));
-          backend->enableVertexAttribute(1 /* uvLoc       */, 2, sizeof(Vertex), offsetof(Vertex, u));
+          backend->useGpuProgram(m_spriteShader.get());
 
-          currShader = m_quadShader.get();
+          const auto viewScale = getViewScale();
+          SpriteUniformBlock block { { 0, 0, viewScale.x, viewScale.y }, {} };
+          backend->setUniformBlock(&block, sizeof block);
+
+          currShader = m_spriteShader.get();
         }
 
         if(m_tiles[quad.tile].texture != currTexture)
@@ -313,334 +354,968 @@ struct Renderer : IRenderer
           currTexture->bind(0); // Bind our diffuse texture in Texture Unit 0
         }
 
-        if(quad.light != currLight)
-        {
+        if((int)instances.size() >= MAX_QUADS)
           flushBatch();
 
-          MyUniformBlock block { quad.light[0], quad.light[1], quad.light[2], 0 };
-          backend->setUniformBlock(&block, sizeof block);
-          currLight = quad.light;
-        }
-
-        if(vboData.size() * 6 >= MAX_QUADS)
-          flushBatch();
-
-        const auto& tile = m_tiles[quad.tile];
-        const float u0 = tile.uv[0].x;
-        const float v0 = 1 - tile.uv[1].y;
-        const float u1 = tile.uv[1].x;
-        const float v1 = 1 - tile.uv[0].y;
-
-        vboData.push_back({ quad.pos[0].x, quad.pos[0].y, u0, v0 });
-        vboData.push_back({ quad.pos[1].x, quad.pos[1].y, u0, v1 });
-        vboData.push_back({ quad.pos[2].x, quad.pos[2].y, u1, v1 });
-
-        vboData.push_back({ quad.pos[0].x, quad.pos[0].y, u0, v0 });
-        vboData.push_back({ quad.pos[2].x, quad.pos[2].y, u1, v1 });
-        vboData.push_back({ quad.pos[3].x, quad.pos[3].y, u1, v0 });
+        instances.push_back(m_spriteInstances[quad.instance]);
       };
 
-    while(lines.len || circles.len || quads.len)
+    bool tileLayerPending = m_tileLayer.draw;
+
+    while(shapes.len || quads.len || tileLayerPending)
     {
       float minZ = 1.0 / 0.0;
 
-      if(lines.len && lines[0].zOrder < minZ)
-        minZ = lines[0].zOrder;
+      if(tileLayerPending && m_tileLayer.zOrder < minZ)
+        minZ = m_tileLayer.zOrder;
 
-      if(circles.len && circles[0].zOrder < minZ)
-        minZ = circles[0].zOrder;
+      if(shapes.len && shapes[0].zOrder < minZ)
+        minZ = shapes[0].zOrder;
 
-      if(quads.len && quads[0].zOrder < minZ)
-        minZ = quads[0].zOrder;
+      if(quads.len && m_quads[quads[0].index].zOrder < minZ)
+        minZ = m_quads[quads[0].index].zOrder;
 
-      while(lines.len > 0 && lines[0].zOrder == minZ)
+      if(tileLayerPending && m_tileLayer.zOrder == minZ)
       {
-        addOneLine(lines[0]);
-        lines += 1;
+        flushBatch();
+
+        if(m_tileLayer.indices)
+          drawTileLayerMap();
+        else
+          drawTileLayerChunks();
+
+        tileLayerPending = false;
+
+        // the program state must be set up again
+        currShader = nullptr;
+        currTexture = nullptr;
       }
 
-      while(circles.len > 0 && circles[0].zOrder == minZ)
+      while(shapes.len > 0 && shapes[0].zOrder == minZ)
       {
-        addOneCircle(circles[0]);
-        circles += 1;
+        addOneShape(shapes[0]);
+        shapes += 1;
       }
 
-      while(quads.len > 0 && quads[0].zOrder == minZ)
+      while(quads.len > 0 && m_quads[quads[0].index].zOrder == minZ)
       {
-        addOneQuad(quads[0]);
+        addOneQuad(m_quads[quads[0].index]);
         quads += 1;
       }
     }
 
     flushBatch();
 
-    ggSpriteCount = m_quads.size();
+    ggSpriteCount = m_quadOrder.size();
     ggBatchCount = batchCount;
-    ggVboCap = vboData.capacity();
+    ggInstanceBytes = instanceBytes;
+    ggVboCap = instances.capacity() * sizeof(SpriteInstance) + shapeInstances.capacity() * sizeof(ShapeInstance);
+
+    // the texts not drawn during this frame are forgotten
+    for(auto it = m_texts.begin(); it != m_texts.end();)
+    {
+      if(it->second.lastFrame != m_frameCount)
+        it = m_texts.erase(it);
+      else
+        ++it;
+    }
+
+    ggTextsRebuilt = m_textsRebuilt;
+    m_textsRebuilt = 0;
 
     m_quads.clear();
-    m_circles.clear();
-    m_lines.clear();
+    m_worldSprites.clear();
+    m_screenSprites.clear();
+    m_shapes.clear();
+    m_tileLayer.draw = false;
   }
 
   int batchCount = 0;
+  int instanceBytes = 0; // uploaded during this frame
 
   void flushBatch()
   {
-    if(vboData.empty())
-      return;
+    if(!shapeInstances.empty())
+    {
+      const int firstInstance = m_instanceVbo->append(shapeInstances.data(), shapeInstances.size(), sizeof(shapeInstances[0]));
+      drawShapes(firstInstance, shapeInstances.size());
+      instanceBytes += shapeInstances.size() * sizeof(ShapeInstance);
+
+      shapeInstances.clear();
 
-    m_batchVbo->upload(vboData.data(), vboData.size() * sizeof(vboData[0]));
-    backend->useVertexBuffer(m_batchVbo.get());
-    backend->draw(vboData.size());
+      ++batchCount;
+    }
+
+    if(!instances.empty())
+    {
+      const int firstInstance = m_instanceVbo->append(instances.data(), instances.size(), sizeof(instances[0]));
+      drawInstances(m_instanceVbo.get(), firstInstance, instances.size());
+      instanceBytes += instances.size() * sizeof(SpriteInstance);
+
+      instances.clear();
+
+      ++batchCount;
+    }
+  }
+
+  // draws 'count' sprites from 'vbo', with the sprite program
+  void drawInstances(IVertexBuffer* vbo, int first, int count)
+  {
+    backend->useVertexBuffer(m_quadVbo.get());
+    backend->enableVertexAttribute(0 /* cornerLoc   */, 2, sizeof(Vertex), offsetof(Vertex, x), AttributeType::Short, true);
+    backend->enableVertexAttribute(1 /* cornerUvLoc */, 2, sizeof(Vertex), offsetof(Vertex, u), AttributeType::Short, true);
+
+    // GLES3 has no 'base instance': offset the per-instance attributes instead
+    const int base = first * sizeof(SpriteInstance);
+    backend->useVertexBuffer(vbo);
+    const int attributes = base + offsetof(SpriteInstance, attributes);
+    backend->enableInstanceAttribute(2 /* posLoc      */, 2, sizeof(SpriteInstance), base + offsetof(SpriteInstance, x));
+    backend->enableInstanceAttribute(3 /* angleLoc    */, 1, sizeof(SpriteInstance), base + offsetof(SpriteInstance, angle));
+    backend->enableInstanceAttribute(4 /* sizeLoc     */, 2, sizeof(SpriteInstance), attributes + offsetof(SpriteAttributes, w), AttributeType::Short, false);
+    backend->enableInstanceAttribute(5 /* uvRectLoc   */, 4, sizeof(SpriteInstance), attributes + offsetof(SpriteAttributes, u0), AttributeType::UnsignedShort, true);
+    backend->enableInstanceAttribute(6 /* lightLoc    */, 3, sizeof(SpriteInstance), attributes + offsetof(SpriteAttributes, r), AttributeType::Byte, true);
+    backend->drawInstanced(6, count);
+  }
+
+  // draws 'count' shapes from the instance VBO, with the shape program
+  void drawShapes(int first, int count)
+  {
+    backend->useVertexBuffer(m_quadVbo.get());
+    backend->enableVertexAttribute(0 /* cornerLoc  */, 2, sizeof(Vertex), offsetof(Vertex, x), AttributeType::Short, true);
+
+    const int base = first * sizeof(ShapeInstance);
+    backend->useVertexBuffer(m_instanceVbo.get());
+    backend->enableInstanceAttribute(1 /* endsLoc   */, 4, sizeof(ShapeInstance), base + offsetof(ShapeInstance, x0));
+    backend->enableInstanceAttribute(2 /* paramsLoc */, 2, sizeof(ShapeInstance), base + offsetof(ShapeInstance, thickness));
+    backend->enableInstanceAttribute(3 /* colorLoc  */, 4, sizeof(ShapeInstance), base + offsetof(ShapeInstance, color));
+    backend->drawInstanced(6, count);
+  }
 
-    vboData.clear();
+  // the tiles are in world space: the camera translation is done by the vertex shader.
+  // (the camera never rotates)
+  SpriteUniformBlock getTileLayerUniformBlock() const
+  {
+    const auto viewScale = getViewScale();
+    SpriteUniformBlock block {};
+    block.viewTransform[0] = -m_camera.pos.x;
+    block.viewTransform[1] = -m_camera.pos.y;
+    block.viewTransform[2] = viewScale.x;
+    block.viewTransform[3] = viewScale.y;
+    block.lightOffset[0] = m_ambientLight;
+    block.lightOffset[1] = m_ambientLight;
+    block.lightOffset[2] = m_ambientLight;
+    return block;
+  }
+
+  // one screen-covering quad, the fragment shader finds the tile of each pixel
+  void drawTileLayerMap()
+  {
+    auto block = getTileLayerUniformBlock();
+
+    backend->useGpuProgram(m_tilemapShader.get());
+    backend->setUniformBlock(&block, sizeof block);
+
+    m_tileLayer.texture->bind(0);
+    m_tileLayer.indices->bind(1);
+    m_tileLayer.palette->bind(2);
+
+    backend->useVertexBuffer(m_quadVbo.get());
+    backend->enableVertexAttribute(0 /* positionLoc */, 2, sizeof(Vertex), offsetof(Vertex, x), AttributeType::Short, true);
+    backend->draw(6);
 
     ++batchCount;
   }
 
-  void drawText(const RenderText& text) override
+  // fallback, when the tiles use several textures: instanced chunks
+  void drawTileLayerChunks()
   {
-    Vec2f size = { 0.5, 0.5 };
+    const auto viewScale = getViewScale();
+    auto block = getTileLayerUniformBlock();
 
-    auto pos = text.pos;
+    backend->useGpuProgram(m_spriteShader.get());
+    backend->setUniformBlock(&block, sizeof block);
 
-    pos.x = pos.x - text.text.len * size.x * 0.5;
-    pos.y = pos.y;
+    // visible part of the world
+    const Vec2f halfView = { 1.0f / viewScale.x, 1.0f / viewScale.y };
+    const Vec2f viewMin = m_camera.pos - halfView;
+    const Vec2f viewMax = m_camera.pos + halfView;
 
-    for(auto& c : text.text)
+    int drawnChunks = 0;
+    ITexture* currTexture = nullptr;
+
+    for(auto& chunk : m_tileLayer.chunks)
     {
-      RenderSprite s {};
-      s.pos = pos;
-      s.halfSize = size;
-      s.modelId = -1;
-      s.zOrder = 100;
-      s.actionIdx = c;
-      s.frame = 0;
+      if(chunk.max.x < viewMin.x || chunk.min.x > viewMax.x || chunk.max.y < viewMin.y || chunk.min.y > viewMax.y)
+        continue;
 
-      drawSprite(s);
-      pos.x += size.x;
+      if(chunk.texture != currTexture)
+      {
+        currTexture = chunk.texture;
+        currTexture->bind(0);
+      }
+
+      drawInstances(m_tileLayer.vbo.get(), chunk.first, chunk.count);
+      ++drawnChunks;
+      ++batchCount;
     }
+
+    ggTileChunks = drawnChunks;
   }
 
-  void drawCircle(const RenderCircle& circle) override
+  void loadTileLayer(const RenderTileLayer& layer) override
   {
-    auto cam = circle.useWorldRefFrame ? m_camera : Camera();
-    const auto transform = getCameraMatrix(cam);
-
-    RenderCircle c = circle;
-    Vec2f p = circle.pos + Vec2f(circle.radius, 0);
-    c.pos = multiplyMatrix(transform, circle.pos.x, circle.pos.y, 1);
-    c.radius = (c.pos - multiplyMatrix(transform, p.x, p.y, 1)).x;
+    // kept, to build the layer again if the atlas gets repacked
+    m_tileLayer.tiles.assign(layer.tiles.data, layer.tiles.data + layer.tiles.len);
+    m_tileLayer.source = layer;
+    m_tileLayer.source.tiles = m_tileLayer.tiles;
 
-    m_circles.push_back(c);
+    buildTileLayer();
   }
 
-  void drawLine(const RenderLine& line) override
+  void buildTileLayer()
   {
-    auto cam = line.useWorldRefFrame ? m_camera : Camera();
-    const auto transform = getCameraMatrix(cam);
+    const auto& layer = m_tileLayer.source;
 
-    RenderLine l = line;
-    l.a = multiplyMatrix(transform, line.a.x, line.a.y, 1);
-    l.b = multiplyMatrix(transform, line.b.x, line.b.y, 1);
+    m_tileLayer.zOrder = layer.zOrder;
+    m_tileLayer.chunks.clear();
+    m_tileLayer.indices.reset();
+    m_tileLayer.palette.reset();
 
-    m_lines.push_back(l);
-  }
+    if(loadTileLayerAsMap(layer))
+      return;
 
-  void drawSprite(const RenderSprite& sprite) override
-  {
-    auto cam = sprite.useWorldRefFrame ? m_camera : Camera();
-    auto it = m_Models.find(sprite.modelId);
+    if(!m_tileLayer.vbo)
+      m_tileLayer.vbo = backend->createVertexBuffer();
 
-    if(it == m_Models.end())
+    std::vector<SpriteInstance> layerInstances;
+    const float noLight[3] = {}; // the ambient light is a uniform
+
+    for(int chunkY = 0; chunkY < layer.size.y; chunkY += TILE_CHUNK_SIZE)
     {
-      char buffer[256];
-      throw Error(format(buffer, "No such model: %d", sprite.modelId));
+      for(int chunkX = 0; chunkX < layer.size.x; chunkX += TILE_CHUNK_SIZE)
+      {
+        const int chunkW = std::min(TILE_CHUNK_SIZE, layer.size.x - chunkX);
+        const int chunkH = std::min(TILE_CHUNK_SIZE, layer.size.y - chunkY);
+
+        // one chunk per texture used in this part of the layer
+        std::unordered_map<ITexture*, std::vector<SpriteInstance>> byTexture;
+
+        for(int y = chunkY; y < chunkY + chunkH; ++y)
+        {
+          for(int x = chunkX; x < chunkX + chunkW; ++x)
+          {
+            const int action = layer.tiles.data[x + y * layer.size.x];
+
+            if(action == -1)
+              continue;
+
+            const auto& tile = m_tiles[findTile(layer.modelId, action, 0)];
+
+            SpriteInstance instance {};
+            instance.x = x + 0.5;
+            instance.y = y + 0.5;
+            instance.attributes = packSpriteAttributes({ 1, 1 }, tile.uv, noLight);
+            byTexture[tile.texture].push_back(instance);
+          }
+        }
+
+        for(auto& pair : byTexture)
+        {
+          TileChunk chunk;
+          chunk.min = Vec2f(chunkX, chunkY);
+          chunk.max = Vec2f(chunkX + chunkW, chunkY + chunkH);
+          chunk.texture = pair.first;
+          chunk.first = layerInstances.size();
+          chunk.count = pair.second.size();
+          m_tileLayer.chunks.push_back(chunk);
+
+          layerInstances.insert(layerInstances.end(), pair.second.begin(), pair.second.end());
+        }
+      }
     }
 
-    auto& model = it->second;
+    m_tileLayer.vbo->upload(layerInstances.data(), layerInstances.size() * sizeof(SpriteInstance));
+  }
 
-    if(model.actions.empty())
+  // uploads the layer as an index texture (one texel per tile) and a palette.
+  // Returns false if the layer can't be represented this way.
+  bool loadTileLayerAsMap(const RenderTileLayer& layer)
+  {
+    if(!m_tilemapShader)
+      return false;
+
+    if(layer.size.x > MAX_TILEMAP_SIZE || layer.size.y > MAX_TILEMAP_SIZE)
+      return false;
+
+    ITexture* texture = nullptr;
+    std::unordered_map<int, int> paletteIndices; // tile -> palette index
+    std::vector<float> palette; // 4 floats per entry
+    std::vector<uint16_t> indices(layer.size.x * layer.size.y);
+
+    for(int i = 0; i < (int)indices.size(); ++i)
     {
-      char buffer[256];
-      throw Error(format(buffer, "model %d has no actions", sprite.modelId));
+      const int action = layer.tiles.data[i];
+
+      if(action == -1)
+        continue;
+
+      const int tileIdx = findTile(layer.modelId, action, 0);
+      const auto& tile = m_tiles[tileIdx];
+
+      // the shader samples only one texture
+      if(texture && tile.texture != texture)
+        return false;
+
+      texture = tile.texture;
+
+      auto it = paletteIndices.find(tileIdx);
+
+      if(it == paletteIndices.end())
+      {
+        if((int)paletteIndices.size() >= MAX_TILEMAP_SIZE)
+          return false;
+
+        it = paletteIndices.insert({ tileIdx, (int)paletteIndices.size() }).first;
+        palette.insert(palette.end(), { tile.uv[0].x, 1 - tile.uv[1].y, tile.uv[1].x, 1 - tile.uv[0].y });
+      }
+
+      indices[i] = 1 + it->second; // 0 means 'empty'
     }
 
-    if(sprite.actionIdx < 0 || sprite.actionIdx >= (int)model.actions.size())
-      throw Error("invalid action index");
+    if(!texture)
+      return false;
 
-    auto const& action = model.actions[sprite.actionIdx];
+    m_tileLayer.texture = texture;
 
-    if(action.textures.empty())
-      throw Error("action has no textures");
+    m_tileLayer.indices = backend->createTexture();
+    m_tileLayer.indices->create(layer.size, TextureFormat::R16ui);
+    m_tileLayer.indices->uploadRaw(indices.data(), layer.size);
 
-    auto const N = (int)action.textures.size();
-    auto const idx = ::clamp<int>(sprite.frame * N, 0, N - 1);
+    const Vec2i paletteSize = { (int)paletteIndices.size(), 1 };
+    m_tileLayer.palette = backend->createTexture();
+    m_tileLayer.palette->create(paletteSize, TextureFormat::Rgba32f);
+    m_tileLayer.palette->uploadRaw(palette.data(), paletteSize);
 
-    Vec2f pos = sprite.pos;
+    return true;
+  }
 
-    const auto worldTransform = computeTransform(pos, sprite.angle, sprite.halfSize);
-    const auto transform = getCameraMatrix(cam) * worldTransform;
+  void drawTileLayer() override
+  {
+    m_tileLayer.draw = true;
+  }
 
-    Quad q;
-    q.zOrder = sprite.zOrder;
-    q.tile = action.textures[idx];
+  // Texts are drawn in the screen reference frame.
+  // Their glyphs are kept from one frame to the next: most texts don't change.
+  void drawText(const RenderText& text) override
+  {
+    auto& cached = m_texts[hashText(text)];
 
-    auto const m0x = -0.5;
-    auto const m0y = -0.5;
-    auto const m1x = +0.5;
-    auto const m1y = +0.5;
+    // on a hash collision, the entry just gets rebuilt
+    if(!cached.matches(text, m_ambientLight))
+      buildText(cached, text);
 
-    q.pos[0] = multiplyMatrix(transform, m0x, m0y, 1);
-    q.pos[1] = multiplyMatrix(transform, m0x, m1y, 1);
-    q.pos[2] = multiplyMatrix(transform, m1x, m1y, 1);
-    q.pos[3] = multiplyMatrix(transform, m1x, m0y, 1);
+    cached.lastFrame = m_frameCount;
 
-    // lighting
+    const int first = m_screenSprites.size();
+    m_screenSprites.append(cached.glyphs);
+
+    for(int i = 0; i < (int)cached.tiles.size(); ++i)
     {
-      q.light[0] = m_ambientLight;
-      q.light[1] = m_ambientLight;
-      q.light[2] = m_ambientLight;
+      Quad q;
+      q.zOrder = TextZOrder;
+      q.tile = cached.tiles[i];
+      q.key = makeSortKey(q.zOrder, m_tiles[q.tile].textureId, m_quads.size());
+      q.instance = first + i;
+      q.screenRefFrame = true;
+      m_quads.push_back(q);
+    }
+  }
+
+  void drawCircle(const RenderCircle& circle) override
+  {
+    const auto center = toViewSpace(circle, circle.pos);
+    pushShape(circle, ShapeKind::Circle, center, { circle.radius, 0 }, circle.thickness, circle.color);
+  }
+
+  void drawLine(const RenderLine& line) override
+  {
+    const auto a = toViewSpace(line, line.a);
+    const auto b = toViewSpace(line, line.b);
+    pushShape(line, ShapeKind::Line, a, b, line.thickness, line.color);
+  }
 
-      if(sprite.blinking)
+  void drawRect(const RenderRect& rect) override
+  {
+    const auto a = toViewSpace(rect, rect.pos[0]);
+    const auto b = toViewSpace(rect, rect.pos[1]);
+    pushShape(rect, ShapeKind::Rect, a, b, rect.thickness, rect.color);
+  }
+
+  void drawSprite(const RenderSprite& sprite) override
+  {
+    // the sprite is moved to view space when the frame ends, with all the others
+    auto& batch = sprite.useWorldRefFrame ? m_worldSprites : m_screenSprites;
+
+    Quad q;
+    q.zOrder = sprite.zOrder;
+    q.tile = findTile(sprite.modelId, sprite.actionIdx, sprite.frame);
+    q.key = makeSortKey(q.zOrder, m_tiles[q.tile].textureId, m_quads.size());
+    q.instance = batch.size();
+    q.screenRefFrame = !sprite.useWorldRefFrame;
+
+    // lighting
+    float light[3] = { m_ambientLight, m_ambientLight, m_ambientLight };
+
+    if(sprite.blinking)
+    {
+      if((m_frameCount / 4) % 2)
       {
-        if((m_frameCount / 4) % 2)
-        {
-          q.light[0] = 0.8;
-          q.light[1] = 0.4;
-          q.light[2] = 0.4;
-        }
+        light[0] = 0.8;
+        light[1] = 0.4;
+        light[2] = 0.4;
       }
     }
 
-    // early culling
+    batch.push(sprite.pos, sprite.halfSize, sprite.angle, m_tiles[q.tile].uv, light);
+    m_quads.push_back(q);
+  }
+
+private:
+  static const int TextZOrder = 100;
+
+  // the glyphs of a text, ready to be appended to the screen sprite batch
+  struct CachedText
+  {
+    std::string text;
+    Vec2f pos;
+    float light = 0;
+    SpriteBatch glyphs;
+    std::vector<int> tiles; // indices into 'm_tiles', one per glyph
+    int lastFrame = 0;
+
+    bool matches(const RenderText& t, float ambientLight) const
     {
-      BoundingBox box(q.pos[0]);
+      return t.text.len == (int)text.size() && !memcmp(t.text.data, text.data(), text.size()) && t.pos == pos && ambientLight == light;
+    }
+  };
+
+  void buildText(CachedText& cached, const RenderText& text)
+  {
+    const Vec2f size = { 0.5, 0.5 };
+    const float light[3] = { m_ambientLight, m_ambientLight, m_ambientLight };
 
-      for(auto& p : q.pos)
-        box.add(p);
+    cached.text.assign(text.text.data, text.text.len);
+    cached.pos = text.pos;
+    cached.light = m_ambientLight;
+    cached.glyphs.clear();
+    cached.tiles.clear();
+
+    auto pos = text.pos;
+    pos.x = pos.x - text.text.len * size.x * 0.5;
 
-      if(box.max.x < -1.0 || box.min.x > 1.0 || box.max.y < -1.0 || box.min.y > 1.0)
-        return;
+    for(auto& c : text.text)
+    {
+      const int tile = findTile(-1, c, 0);
+      cached.glyphs.push(pos, size, 0, m_tiles[tile].uv, light);
+      cached.tiles.push_back(tile);
+      pos.x += size.x;
     }
 
-    m_quads.push_back(q);
+    ++m_textsRebuilt;
   }
 
-private:
-  Matrix3f getCameraMatrix(const Camera& cam) const
+  Vec2f toViewSpace(const RenderObject& object, Vec2f pos) const
   {
-    static const auto half_w = m_internalResolution.x / 2;
-    static const auto half_h = m_internalResolution.y / 2;
-    static const auto shrink = scale(Vec2f(TILE_SIZE / half_w, TILE_SIZE / half_h));
-    return shrink * rotate(-cam.angle) * translate(-1 * cam.pos);
+    auto cam = object.useWorldRefFrame ? m_camera : Camera();
+    return multiplyMatrix(getViewMatrix(cam), pos.x, pos.y, 1);
+  }
+
+  void pushShape(const RenderObject& object, ShapeKind kind, Vec2f p0, Vec2f p1, float thickness, RenderColor color)
+  {
+    Shape shape;
+    shape.zOrder = object.zOrder;
+
+    auto& instance = shape.instance;
+    instance.x0 = p0.x;
+    instance.y0 = p0.y;
+    instance.x1 = p1.x;
+    instance.y1 = p1.y;
+    instance.thickness = thickness;
+    instance.kind = (float)kind;
+    instance.color[0] = color.r;
+    instance.color[1] = color.g;
+    instance.color[2] = color.b;
+    instance.color[3] = color.a;
+
+    m_shapes.push_back(shape);
+  }
+
+  // culling, on a box containing the sprite whatever its angle
+  bool isVisible(const SpriteInstance& instance) const
+  {
+    const auto viewScale = getViewScale();
+    const float radius = (std::abs(instance.attributes.w) + std::abs(instance.attributes.h)) * 0.5 / SpriteSizeScale;
+    const Vec2f min = { (instance.x - radius) * viewScale.x, (instance.y - radius) * viewScale.y };
+    const Vec2f max = { (instance.x + radius) * viewScale.x, (instance.y + radius) * viewScale.y };
+
+    return !(max.x < -1.0 || min.x > 1.0 || max.y < -1.0 || min.y > 1.0);
+  }
+
+  // returns an index into 'm_tiles'
+  int findTile(int modelId, int actionIdx, float frame) const
+  {
+    auto it = m_Models.find(modelId);
+
+    if(it == m_Models.end())
+    {
+      char buffer[256];
+      throw Error(format(buffer, "No such model: %d", modelId));
+    }
+
+    auto& model = it->second;
+
+    if(model.actions.empty())
+    {
+      char buffer[256];
+      throw Error(format(buffer, "model %d has no actions", modelId));
+    }
+
+    if(actionIdx < 0 || actionIdx >= (int)model.actions.size())
+      throw Error("invalid action index");
+
+    auto const& action = model.actions[actionIdx];
+
+    if(action.textures.empty())
+      throw Error("action has no textures");
+
+    auto const N = (int)action.textures.size();
+    auto const idx = ::clamp<int>(frame * N, 0, N - 1);
+
+    return action.textures[idx];
+  }
+
+  // world space to view space
+  static Matrix3f getViewMatrix(const Camera& cam)
+  {
+    return rotate(-cam.angle) * translate(-1 * cam.pos);
+  }
+
+  // view space to clip space
+  Vec2f getViewScale() const
+  {
+    const auto half_w = m_internalResolution.x / 2;
+    const auto half_h = m_internalResolution.y / 2;
+    return Vec2f(TILE_SIZE / half_w, TILE_SIZE / half_h);
   }
 
   Camera m_camera;
-  bool m_cameraValid = false;
 
   std::unique_ptr<IGpuProgram> m_quadShader;
-  std::unique_ptr<IGpuProgram> m_lineShader;
+  std::unique_ptr<IGpuProgram> m_spriteShader;
+  std::unique_ptr<IGpuProgram> m_shapeShader;
+  std::unique_ptr<IGpuProgram> m_tilemapShader;
 
   struct Quad
   {
+    uint64_t key;
     int zOrder;
-    std::array<float, 3> light {};
     int tile;
-    Vec2f pos[4];
+    int instance; // index into its sprite batch
+    bool screenRefFrame;
   };
 
   struct Tile
   {
     ITexture* texture;
+    int textureId; // for sorting
     Vec2f uv[2];
+
+    std::string path; // the region of the atlas. Empty for a free tile, or a baked one
+    Rect2f frect; // the part of the region, in [0;1]
   };
 
+  // one picture file, in the atlas
   struct AtlasedTexture
   {
+    int page;
     Vec2i pos;
     Vec2i dim;
+    int refCount = 0; // number of tiles using it
+  };
+
+  struct AtlasPage
+  {
+    std::unique_ptr<ITexture> texture;
+    SkylinePacker packer { AtlasSize };
+    int liveArea = 0; // not counting the regions evicted since the last packing
+  };
+
+  struct Shape
+  {
+    int zOrder;
+    ShapeInstance instance;
   };
 
-  std::vector<RenderCircle> m_circles;
-  std::vector<RenderLine> m_lines;
+  std::vector<Shape> m_shapes;
   std::vector<Quad> m_quads;
-  std::unique_ptr<IVertexBuffer> m_batchVbo;
+  SpriteBatch m_worldSprites;
+  SpriteBatch m_screenSprites;
+  std::vector<SpriteInstance> m_spriteInstances;
+  std::unordered_map<uint64_t, CachedText> m_texts; // by 'hashText'
+  int m_textsRebuilt = 0; // during the current frame
+
+  struct TileChunk
+  {
+    Vec2f min, max; // world space
+    ITexture* texture;
+    int first; // instance index in the layer VBO
+    int count;
+  };
+
+  struct TileLayer
+  {
+    RenderTileLayer source {};
+    std::vector<int> tiles; // pointed to by 'source'
+    int zOrder = 0;
+
+    // drawn as a tilemap, when all the tiles use the same texture
+    ITexture* texture = nullptr;
+    std::unique_ptr<ITexture> indices;
+    std::unique_ptr<ITexture> palette;
+
+    // otherwise, drawn as instanced chunks
+    std::vector<TileChunk> chunks;
+    std::unique_ptr<IVertexBuffer> vbo;
+    bool draw = false; // requested for the current frame
+  };
+
+  TileLayer m_tileLayer;
+  std::vector<my::KeyIndex> m_quadOrder;
+  std::vector<my::KeyIndex> m_quadOrderTmp; // radix sort scratch buffer
+  std::unique_ptr<IVertexBuffer> m_instanceVbo;
   std::unique_ptr<IVertexBuffer> m_quadVbo;
   std::unique_ptr<IFrameBuffer> m_fb;
 
   std::unordered_map<int, Model> m_Models;
   std::unordered_map<std::string, AtlasedTexture> m_atlasedTextures;
+  std::vector<AtlasPage> m_atlasPages;
   std::vector<Tile> m_tiles;
+  std::vector<int> m_freeTiles; // indices into 'm_tiles'
+
+  std::string m_bakedAtlasData; // pointed to by 'm_bakedAtlas'
+  BakedAtlas m_bakedAtlas;
+  std::vector<std::unique_ptr<ITexture>> m_bakedPages;
+  std::unordered_map<std::string, int> m_bakedModels; // path -> index into 'm_bakedAtlas.models'
 
-  std::vector<Vertex> vboData; // VBO scratch buffer
-  std::unique_ptr<ITexture> m_atlasTexture;
-  Vec2i m_atlasFreeSpacePointer {};
-  int m_atlasMaxHeightOnCurrentLine = 0;
+  std::vector<SpriteInstance> instances; // instance VBO scratch buffers
+  std::vector<ShapeInstance> shapeInstances;
   float m_ambientLight = 0;
   int m_frameCount = 0;
 
   IGraphicsBackend* const backend;
   const Vec2i m_internalResolution;
 
-  Vec2i findFreePosInAtlas(Vec2i dim)
+  int loadTexture(String path, Rect2f frect)
   {
-    if(m_atlasFreeSpacePointer.x + dim.x > AtlasSize.x)
+    const std::string sPath(path.data, path.len);
+
+    auto it = m_atlasedTextures.find(sPath);
+
+    if(it == m_atlasedTextures.end())
     {
-      // the texture doesn't fit on this line, create a new line
-      m_atlasFreeSpacePointer.x = 0;
-      m_atlasFreeSpacePointer.y += m_atlasMaxHeightOnCurrentLine;
+      auto pic = loadPicture(path);
+      const AtlasedTexture tex = allocateRegion(pic.dim);
+      m_atlasPages[tex.page].texture->upload(pic, tex.pos);
+      m_atlasPages[tex.page].liveArea += tex.dim.x * tex.dim.y;
+
+      it = m_atlasedTextures.insert({ sPath, tex }).first;
+
+      if(0)
+        logMsg("[renderer] loaded '%.*s' at (%d;%d), page %d", path.len, path.data, tex.pos.x, tex.pos.y, tex.page);
     }
 
-    if(m_atlasFreeSpacePointer.y + dim.y >= AtlasSize.y)
+    it->second.refCount++;
+
+    const int id = allocateTile();
+    auto& tile = m_tiles[id];
+    tile.path = sPath;
+    tile.frect = frect;
+    updateTile(tile);
+
+    updateAtlasGauges();
+    return id;
+  }
+
+  int allocateTile()
+  {
+    if(m_freeTiles.size())
+    {
+      const int id = m_freeTiles.back();
+      m_freeTiles.pop_back();
+      return id;
+    }
+
+    m_tiles.push_back({});
+    return (int)m_tiles.size() - 1;
+  }
+
+  // the pages are uploaded once, and stay for the whole session
+  void loadBakedAtlas()
+  {
+    m_bakedAtlasData = File::read(BakedAtlasPath);
+    m_bakedAtlas = openBakedAtlas({ (const uint8_t*)m_bakedAtlasData.data(), (int)m_bakedAtlasData.size() });
+
+    for(auto& page : m_bakedAtlas.pages)
+    {
+      auto texture = backend->createTexture();
+      texture->create({ page.width, page.height });
+      texture->uploadRaw(m_bakedAtlas.pixels(page), { page.width, page.height });
+      m_bakedPages.push_back(std::move(texture));
+    }
+
+    for(int i = 0; i < m_bakedAtlas.models.len; ++i)
+    {
+      const auto path = m_bakedAtlas.path(m_bakedAtlas.models.data[i]);
+      m_bakedModels[std::string(path.data, path.len)] = i;
+    }
+
+    logMsg("[renderer] baked atlas: %d pages, %d models", m_bakedAtlas.pages.len, m_bakedAtlas.models.len);
+  }
+
+  // no picture decoding, no parsing: the tiles point into the baked pages
+  bool loadBakedModel(String path, Model& model)
+  {
+    auto it = m_bakedModels.find(std::string(path.data, path.len));
+
+    if(it == m_bakedModels.end())
+      return false;
+
+    const auto& bakedModel = m_bakedAtlas.models.data[it->second];
+
+    for(uint32_t i = 0; i < bakedModel.actionCount; ++i)
+    {
+      const auto& bakedAction = m_bakedAtlas.actions.data[bakedModel.firstAction + i];
+      Action action;
+
+      for(uint32_t k = 0; k < bakedAction.frameCount; ++k)
+      {
+        const auto& frame = m_bakedAtlas.frames.data[bakedAction.firstFrame + k];
+        const int id = allocateTile();
+        auto& tile = m_tiles[id];
+        tile.texture = m_bakedPages[frame.page].get();
+        tile.textureId = MAX_ATLAS_PAGES + frame.page;
+        tile.uv[0] = { frame.uv[0], frame.uv[1] };
+        tile.uv[1] = { frame.uv[2], frame.uv[3] };
+        action.textures.push_back(id);
+      }
+
+      model.actions.push_back(std::move(action));
+    }
+
+    return true;
+  }
+
+  void releaseModel(const Model& model)
+  {
+    for(auto& action : model.actions)
+      for(auto tileIdx : action.textures)
+        releaseTile(tileIdx);
+
+    updateAtlasGauges();
+  }
+
+  void releaseTile(int tileIdx)
+  {
+    auto& tile = m_tiles[tileIdx];
+
+    // baked tiles only own their slot
+    if(!tile.path.empty())
+    {
+      auto it = m_atlasedTextures.find(tile.path);
+      auto& tex = it->second;
+
+      if(--tex.refCount == 0)
+      {
+        // evicted: the space gets reclaimed the next time the page is packed
+        auto& page = m_atlasPages[tex.page];
+        page.liveArea -= tex.dim.x * tex.dim.y;
+
+        if(page.liveArea == 0)
+          page.packer.reset();
+
+        m_atlasedTextures.erase(it);
+      }
+    }
+
+    tile = {};
+    m_freeTiles.push_back(tileIdx);
+  }
+
+  // finds room for a new region: in the existing pages, in the existing pages
+  // once packed again without their evicted regions, or in a new page.
+  AtlasedTexture allocateRegion(Vec2i dim)
+  {
+    if(dim.x > AtlasSize.x || dim.y > AtlasSize.y)
+    {
+      char buffer[256];
+      throw Error(format(buffer, "Texture too big for the atlas (%dx%d)", dim.x, dim.y));
+    }
+
+    AtlasedTexture r;
+    r.dim = dim;
+
+    for(r.page = 0; r.page < (int)m_atlasPages.size(); ++r.page)
+    {
+      if(m_atlasPages[r.page].packer.insert(dim, r.pos))
+        return r;
+    }
+
+    for(r.page = 0; r.page < (int)m_atlasPages.size(); ++r.page)
+    {
+      auto& page = m_atlasPages[r.page];
+
+      if(page.packer.usedArea() == page.liveArea)
+        continue; // no holes
+
+      if(!repackPage(r.page))
+        continue;
+
+      if(page.packer.insert(dim, r.pos))
+        return r;
+    }
+
+    if((int)m_atlasPages.size() >= MAX_ATLAS_PAGES)
     {
       char buffer[256];
       throw Error(format(buffer, "Atlas is full"));
     }
 
-    const Vec2i pos = m_atlasFreeSpacePointer;
-    m_atlasFreeSpacePointer.x += dim.x;
-    m_atlasMaxHeightOnCurrentLine = std::max(m_atlasMaxHeightOnCurrentLine, dim.y);
-    return pos;
+    AtlasPage page;
+    page.texture = backend->createTexture();
+    page.texture->create(AtlasSize);
+    m_atlasPages.push_back(std::move(page));
+
+    r.page = (int)m_atlasPages.size() - 1;
+
+    if(!m_atlasPages[r.page].packer.insert(dim, r.pos))
+      throw Error("Can't allocate atlas region");
+
+    return r;
   }
 
-  int loadTexture(String path, Rect2f frect)
+  // packs the live regions of a page again, reclaiming the space of the evicted ones.
+  // The moved regions are uploaded again from their files.
+  // Returns false, changing nothing, if they don't fit in the atlas anymore.
+  bool repackPage(int pageIdx)
   {
-    const std::string sPath(path.data, path.len);
+    std::vector<std::pair<const std::string, AtlasedTexture>*> regions;
 
-    if(m_atlasedTextures.find(sPath) == m_atlasedTextures.end())
+    for(auto& pair : m_atlasedTextures)
     {
-      auto pic = loadPicture(path);
-      const Vec2i posInAtlas = findFreePosInAtlas(pic.dim);
-      m_atlasTexture->upload(pic, posInAtlas);
+      if(pair.second.page == pageIdx)
+        regions.push_back(&pair);
+    }
+
+    // the tallest first: it packs tighter
+    auto byHeight = [] (std::pair<const std::string, AtlasedTexture>* a, std::pair<const std::string, AtlasedTexture>* b)
+      {
+        return a->second.dim.y > b->second.dim.y;
+      };
 
-      m_atlasedTextures[sPath] = { posInAtlas, pic.dim };
+    std::sort(regions.begin(), regions.end(), byHeight);
 
-      if(0)
-        logMsg("[renderer] loaded '%.*s' at (%d;%d)", path.len, path.data, posInAtlas.x, posInAtlas.y);
+    std::vector<Vec2i> dims;
+
+    for(auto region : regions)
+      dims.push_back(region->second.dim);
+
+    std::vector<SkylinePacker> packers;
+
+    for(auto& page : m_atlasPages)
+      packers.push_back(page.packer);
+
+    std::vector<AtlasPlacement> placements;
+
+    if(!repackAtlasPage(packers, pageIdx, dims, MAX_ATLAS_PAGES, placements))
+    {
+      logMsg("[renderer] can't repack atlas page %d: its regions don't fit anymore", pageIdx);
+      return false;
+    }
+
+    logMsg("[renderer] repacking atlas page %d (%d regions)", pageIdx, (int)regions.size());
+
+    // pages created for the regions that didn't fit back
+    while(m_atlasPages.size() < packers.size())
+    {
+      AtlasPage page;
+      page.texture = backend->createTexture();
+      page.texture->create(AtlasSize);
+      m_atlasPages.push_back(std::move(page));
     }
 
-    const AtlasedTexture& tex = m_atlasedTextures[sPath];
+    for(int i = 0; i < (int)packers.size(); ++i)
+      m_atlasPages[i].packer = packers[i];
 
-    const float texLocalLeft = frect.pos.x;
-    const float texLocalRight = frect.pos.x + frect.size.x;
-    const float texLocalTop = 1 - frect.pos.y;
-    const float texLocalBottom = 1 - (frect.pos.y + frect.size.y);
+    m_atlasPages[pageIdx].liveArea = 0;
 
-    const int leftInPixels = tex.pos.x + (texLocalLeft * tex.dim.x);
-    const int rightInPixels = tex.pos.x + (texLocalRight * tex.dim.x);
-    const int topInPixels = tex.pos.y + (texLocalTop * tex.dim.y);
-    const int bottomInPixels = tex.pos.y + (texLocalBottom * tex.dim.y);
+    for(int i = 0; i < (int)regions.size(); ++i)
+    {
+      auto& tex = regions[i]->second;
+      const int oldPage = tex.page;
+      const Vec2i oldPos = tex.pos;
 
-    const float left = leftInPixels / float(AtlasSize.x);
-    const float right = rightInPixels / float(AtlasSize.x);
-    const float top = 1 - topInPixels / float(AtlasSize.y);
-    const float bottom = 1 - bottomInPixels / float(AtlasSize.y);
+      tex.page = placements[i].page;
+      tex.pos = placements[i].pos;
+      m_atlasPages[tex.page].liveArea += tex.dim.x * tex.dim.y;
 
-    const int id = (int)m_tiles.size();
-    m_tiles.push_back({ m_atlasTexture.get(), { { left, top }, { right, bottom } } });
-    return id;
+      if(tex.page != oldPage || tex.pos != oldPos)
+      {
+        auto pic = loadPicture(regions[i]->first);
+        m_atlasPages[tex.page].texture->upload(pic, tex.pos);
+      }
+    }
+
+    for(auto& tile : m_tiles)
+    {
+      if(!tile.path.empty())
+        updateTile(tile);
+    }
+
+    // the tile layer stores UVs
+    if(m_tileLayer.source.tiles.len)
+      buildTileLayer();
+
+    return true;
+  }
+
+  // computes the texture and UVs of a tile, from its atlas region
+  void updateTile(Tile& tile) const
+  {
+    const AtlasedTexture& tex = m_atlasedTextures.at(tile.path);
+
+    tile.texture = m_atlasPages[tex.page].texture.get();
+    tile.textureId = tex.page;
+    computeAtlasUV(AtlasSize, tex.pos, tex.dim, tile.frect, tile.uv);
+  }
+
+  void updateAtlasGauges()
+  {
+    int liveArea = 0;
+    int coveredArea = 0;
+
+    for(auto& page : m_atlasPages)
+    {
+      liveArea += page.liveArea;
+      coveredArea += page.packer.coveredArea();
+    }
+
+    const int totalArea = m_atlasPages.size() * AtlasSize.x * AtlasSize.y;
+
+    // fragmentation: the part of the packed space not used by live regions
+    // (lost between regions, or evicted)
+    ggAtlasPages = m_atlasPages.size();
+    ggAtlasOccupancy = totalArea ? liveArea * 100.0f / totalArea : 0;
+    ggAtlasFragmentation = coveredArea ? (coveredArea - liveArea) * 100.0f / coveredArea : 0;
   }
 };
 }
@@ -0,0 +1,200 @@
+// Copyright (C) 2025 - Sebastien Alaiwan
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as
+// published by the Free Software Foundation, either version 3 of the
+// License, or (at your option) any later version.
+
+// Benchmark tool: replays a render log (see render_log.h) on the real
+// renderer, as fast as possible, and reports the frame times.
+// This allows comparing renderer changes on identical game frames.
+//
+// Usage: replayrender.exe [options] <render.log>
+//   --software     use the software backend: no window, no GPU
+//   --frames A-B   only replay frames A to B. The previous ones only set the
+//                  renderer state (models, tile layer, camera).
+//   --repeat N     replay the frames N times (default: 1)
+//   --list         print the draw calls of each frame, and exit: helps
+//                  finding the heavy parts of a session
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib> // atoi
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "base/error.h"
+#include "base/logger.h"
+#include "base/renderer.h"
+#include "command_list.h"
+#include "engine/graphics_backend.h"
+#include "misc/file.h"
+#include "misc/stats.h"
+#include "render_log.h"
+
+IGraphicsBackend* createGraphicsBackend(Vec2i resolution);
+IGraphicsBackend* createSoftwareGraphicsBackend(Vec2i resolution);
+IRenderer* createRenderer(IGraphicsBackend* gfxBackend, Vec2i internalResolution);
+
+namespace
+{
+struct CountingRenderer : IRenderer
+{
+  void loadModel(int, String) override {}
+  void setCamera(Vec2f) override {}
+  void setAmbientLight(float) override {}
+
+  void beginDraw() override {}
+  void endDraw() override {}
+  void drawSprite(const RenderSprite&) override { ++sprites; }
+  void drawText(const RenderText&) override { ++texts; }
+  void drawCircle(const RenderCircle&) override { ++shapes; }
+  void drawLine(const RenderLine&) override { ++shapes; }
+  void drawRect(const RenderRect&) override { ++shapes; }
+  void loadTileLayer(const RenderTileLayer&) override {}
+  void drawTileLayer() override { ++tileLayers; }
+
+  int sprites = 0;
+  int texts = 0;
+  int shapes = 0;
+  int tileLayers = 0;
+};
+
+void listFrames(const RenderLog& log)
+{
+  for(int i = 0; i < (int)log.frames.size(); ++i)
+  {
+    CountingRenderer counter;
+    executeCommands(log.frames[i], &counter);
+    printf("frame %d: %d bytes, %d sprites, %d texts, %d shapes, %d tile layers\n",
+           i, log.frames[i].len, counter.sprites, counter.texts, counter.shapes, counter.tileLayers);
+  }
+}
+
+int runMain(int argc, char* argv[])
+{
+  bool software = false;
+  bool list = false;
+  int firstFrame = 0;
+  int lastFrame = -1;
+  int repeat = 1;
+  std::string path;
+
+  for(int i = 1; i < argc; ++i)
+  {
+    std::string arg = argv[i];
+
+    if(arg == "--software")
+      software = true;
+    else if(arg == "--list")
+      list = true;
+    else if(arg == "--repeat" && i + 1 < argc)
+      repeat = std::max(1, atoi(argv[++i]));
+    else if(arg == "--frames" && i + 1 < argc)
+    {
+      if(sscanf(argv[++i], "%d-%d", &firstFrame, &lastFrame) != 2)
+        throw Error("Invalid frame range, expected: A-B");
+    }
+    else
+      path = arg;
+  }
+
+  if(path.empty())
+    throw Error("Usage: replayrender.exe [--software] [--frames A-B] [--repeat N] [--list] <render.log>");
+
+  auto data = File::read(path);
+  auto log = openRenderLog({ (const uint8_t*)data.data(), (int)data.size() });
+
+  if(list)
+  {
+    listFrames(log);
+    return 0;
+  }
+
+  const int frameCount = (int)log.frames.size();
+
+  if(lastFrame < 0 || lastFrame >= frameCount)
+    lastFrame = frameCount - 1;
+
+  firstFrame = std::max(0, firstFrame);
+
+  if(firstFrame > lastFrame)
+    throw Error("Empty frame range");
+
+  // same window size as the game. The software backend skips the upscaling.
+  std::unique_ptr<IGraphicsBackend> backend;
+
+  if(software)
+    backend.reset(createSoftwareGraphicsBackend(log.resolution));
+  else
+    backend.reset(createGraphicsBackend(log.resolution * 4));
+
+  backend->setVsync(false);
+
+  std::unique_ptr<IRenderer> renderer(createRenderer(backend.get(), log.resolution));
+
+  for(int i = 0; i < firstFrame; ++i)
+    executeCommands(log.frames[i], renderer.get(), false);
+
+  std::vector<double> durations;
+  durations.reserve((lastFrame - firstFrame + 1) * repeat);
+
+  auto const start = std::chrono::steady_clock::now();
+
+  for(int k = 0; k < repeat; ++k)
+  {
+    for(int i = firstFrame; i <= lastFrame; ++i)
+    {
+      auto const t0 = std::chrono::steady_clock::now();
+      executeCommands(log.frames[i], renderer.get());
+      renderer->endDraw();
+      auto const t1 = std::chrono::steady_clock::now();
+
+      durations.push_back(std::chrono::duration<double, std::micro>(t1 - t0).count());
+    }
+  }
+
+  auto const seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+  double sum = 0;
+
+  for(auto d : durations)
+    sum += d;
+
+  const double average = sum / durations.size();
+
+  auto p99 = durations.begin() + (durations.size() * 99) / 100;
+  std::nth_element(durations.begin(), p99, durations.end());
+
+  printf("frames: %d (%d-%d, %d times)\n", (int)durations.size(), firstFrame, lastFrame, repeat);
+  printf("frames/s: %.0f\n", durations.size() / seconds);
+  printf("frame duration: average %.1f us, p99 %.1f us\n", average, *p99);
+
+  for(int i = 0; i < getStatCount(); ++i)
+  {
+    auto stat = getStat(i);
+
+    if(stat.name)
+      printf("%s: %.2f\n", stat.name, stat.val);
+  }
+
+  return 0;
+}
+}
+
+int main(int argc, char* argv[])
+{
+  try
+  {
+    return runMain(argc, argv);
+  }
+  catch(Error const& e)
+  {
+    const auto msg = e.message();
+    fflush(stdout);
+    logMsg("Fatal: %.*s", msg.len, msg.data);
+    return 1;
+  }
+}
+
@@ -0,0 +1,933 @@
+// Copyright (C) 2025 - Sebastien Alaiwan
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as
+// published by the Free Software Foundation, either version 3 of the
+// License, or (at your option) any later version.
+
+///////////////////////////////////////////////////////////////////////////////
+// CPU implementation of the graphics backend: no window, no GPU.
+// Textures and frame buffers live in memory, and a small rasterizer runs
+// the programs of the renderer, translated to C++ from assets/shaders.
+// For display-less rendering: golden-image tests, profiling the renderer.
+
+#include <algorithm> // min, max, swap
+#include <cmath>
+#include <cstring> // memcpy
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "base/box.h"
+#include "base/error.h"
+#include "base/geom.h"
+#include "base/span.h"
+#include "base/util.h" // clamp
+#include "engine/graphics_backend.h"
+#include "picture.h"
+
+namespace
+{
+const int MaxAttributes = 8;
+const int MaxTextureUnits = 8;
+const int MaxVaryings = 12;
+const int MaxUniforms = 16; // floats
+
+// positions are stored in 16-bit normalized integers (see renderer.cpp)
+const float PositionRange = 16.0;
+
+// sprite sizes are stored in 16-bit integers (see sprite_batch.h)
+const float SpriteSizeScale = 256.0;
+
+// must match 'ShapeKind' (see renderer.cpp)
+const float KindLine = 0.0;
+const float KindCircle = 1.0;
+
+struct Texel
+{
+  float r, g, b, a;
+};
+
+float fract(float val)
+{
+  return val - std::floor(val);
+}
+
+float mix(float a, float b, float t)
+{
+  return a + (b - a) * t;
+}
+
+int wrap(int val, int size)
+{
+  const int r = val % size;
+  return r < 0 ? r + size : r;
+}
+
+struct SoftTexture : ITexture
+{
+  SoftTexture(SoftTexture** units_) : units(units_)
+  {
+  }
+
+  // deleted textures get unbound
+  ~SoftTexture()
+  {
+    for(int i = 0; i < MaxTextureUnits; ++i)
+    {
+      if(units[i] == this)
+        units[i] = nullptr;
+    }
+  }
+
+  void create(Vec2i size_, TextureFormat format_) override
+  {
+    size = size_;
+    format = format_;
+
+    switch(format)
+    {
+    case TextureFormat::Rgba8: texelSize = 4; break;
+    case TextureFormat::R16ui: texelSize = 2; break;
+    case TextureFormat::Rgba32f: texelSize = 16; break;
+    }
+
+    data.assign(size.x * size.y * texelSize, 0);
+  }
+
+  // bottom row first, like OpenGL does
+  void upload(PictureView pic, Vec2i dstPos) override
+  {
+    checkRegion(pic.dim, dstPos);
+
+    for(int y = 0; y < pic.dim.y; ++y)
+    {
+      auto src = pic.pixels + (pic.dim.y - 1 - y) * pic.stride * 4;
+      memcpy(texelAddress(dstPos.x, dstPos.y + y), src, pic.dim.x * 4);
+    }
+  }
+
+  void uploadRaw(const void* texels, Vec2i dim, Vec2i dstPos) override
+  {
+    checkRegion(dim, dstPos);
+
+    auto src = (const uint8_t*)texels;
+
+    for(int y = 0; y < dim.y; ++y)
+      memcpy(texelAddress(dstPos.x, dstPos.y + y), src + y * dim.x * texelSize, dim.x * texelSize);
+  }
+
+  void setNoRepeat() override
+  {
+    repeat = false;
+  }
+
+  void bind(int unit) override
+  {
+    if(unit < 0 || unit >= MaxTextureUnits)
+      throw Error("Texture unit out of range");
+
+    units[unit] = this;
+  }
+
+  void checkRegion(Vec2i dim, Vec2i pos) const
+  {
+    if(pos.x < 0 || pos.y < 0 || pos.x + dim.x > size.x || pos.y + dim.y > size.y)
+      throw Error("Texture upload out of bounds");
+  }
+
+  uint8_t* texelAddress(int x, int y)
+  {
+    return data.data() + (y * size.x + x) * texelSize;
+  }
+
+  const uint8_t* texelAddress(int x, int y) const
+  {
+    return data.data() + (y * size.x + x) * texelSize;
+  }
+
+  // 'texelFetch'
+  Texel fetch(int x, int y) const
+  {
+    auto p = texelAddress(x, y);
+
+    switch(format)
+    {
+    case TextureFormat::Rgba8:
+      return { p[0] / 255.0f, p[1] / 255.0f, p[2] / 255.0f, p[3] / 255.0f };
+    case TextureFormat::R16ui:
+      {
+        uint16_t val;
+        memcpy(&val, p, sizeof val);
+        return { float(val), 0, 0, 1 };
+      }
+    case TextureFormat::Rgba32f:
+      {
+        Texel r;
+        memcpy(&r, p, sizeof r);
+        return r;
+      }
+    }
+
+    return {};
+  }
+
+  // 'texture', with nearest filtering
+  Texel sample(float u, float v) const
+  {
+    int x = (int)std::floor(u * size.x);
+    int y = (int)std::floor(v * size.y);
+
+    if(repeat)
+    {
+      x = wrap(x, size.x);
+      y = wrap(y, size.y);
+    }
+    else
+    {
+      x = ::clamp(x, 0, size.x - 1);
+      y = ::clamp(y, 0, size.y - 1);
+    }
+
+    return fetch(x, y);
+  }
+
+  void store(int x, int y, Texel val)
+  {
+    auto p = texelAddress(x, y);
+
+    switch(format)
+    {
+    case TextureFormat::Rgba8:
+      p[0] = (uint8_t)std::lround(::clamp(val.r, 0.0f, 1.0f) * 255);
+      p[1] = (uint8_t)std::lround(::clamp(val.g, 0.0f, 1.0f) * 255);
+      p[2] = (uint8_t)std::lround(::clamp(val.b, 0.0f, 1.0f) * 255);
+      p[3] = (uint8_t)std::lround(::clamp(val.a, 0.0f, 1.0f) * 255);
+      break;
+    case TextureFormat::R16ui:
+      {
+        const uint16_t r = (uint16_t)val.r;
+        memcpy(p, &r, sizeof r);
+        break;
+      }
+    case TextureFormat::Rgba32f:
+      memcpy(p, &val, sizeof val);
+      break;
+    }
+  }
+
+  SoftTexture** const units; // the texture units of the backend
+  Vec2i size {};
+  TextureFormat format = TextureFormat::Rgba8;
+  int texelSize = 4;
+  bool repeat = true;
+  std::vector<uint8_t> data; // bottom row first
+};
+
+struct SoftFrameBuffer : IFrameBuffer
+{
+  SoftFrameBuffer(Vec2i resolution, SoftTexture** units) : color(units)
+  {
+    color.create(resolution, TextureFormat::Rgba32f);
+    color.setNoRepeat();
+  }
+
+  ITexture* getColorTexture() override
+  {
+    return &color;
+  }
+
+  SoftTexture color;
+};
+
+struct SoftVertexBuffer : IVertexBuffer
+{
+  void upload(const void* data, size_t len) override
+  {
+    auto src = (const uint8_t*)data;
+    bytes.assign(src, src + len);
+    cursor = (int)len;
+  }
+
+  int append(const void* data, int vertexCount, int vertexSize) override
+  {
+    const int len = vertexCount * vertexSize;
+    int offset = (cursor + vertexSize - 1) / vertexSize * vertexSize;
+
+    // draws are done right away: the previous contents aren't needed anymore
+    if(offset + len > (int)bytes.size())
+    {
+      offset = 0;
+
+      if(len > (int)bytes.size())
+        bytes.resize(len);
+    }
+
+    memcpy(bytes.data() + offset, data, len);
+    cursor = offset + len;
+
+    return offset / vertexSize;
+  }
+
+  std::vector<uint8_t> bytes;
+  int cursor = 0;
+};
+
+enum class ProgramKind
+{
+  Standard,
+  Sprite,
+  Shape,
+  Tilemap,
+};
+
+enum SamplerSlot
+{
+  DiffuseTextureSampler,
+  TileIndices,
+  TilePalette,
+  SamplerCount,
+};
+
+struct SoftProgram : IGpuProgram
+{
+  SoftProgram(ProgramKind kind_) : kind(kind_)
+  {
+  }
+
+  const ProgramKind kind;
+  int samplerUnits[SamplerCount] {}; // like GL, the samplers read from unit 0 by default
+};
+
+struct Attribute
+{
+  bool enabled = false;
+  const SoftVertexBuffer* vb = nullptr;
+  int dim = 0;
+  int stride = 0;
+  int offset = 0;
+  AttributeType type = AttributeType::Float;
+  bool normalized = false;
+  int divisor = 0;
+};
+
+struct ShadedVertex
+{
+  float x, y; // clip space
+  float varyings[MaxVaryings];
+};
+
+// 'gl_Position' and the outputs of the vertex shaders
+void shadeVertex(ProgramKind kind, const float a[MaxAttributes][4], const float* u, ShadedVertex& out)
+{
+  switch(kind)
+  {
+  case ProgramKind::Standard:
+    {
+      out.x = a[0][0] * PositionRange;
+      out.y = a[0][1] * PositionRange;
+      out.varyings[0] = a[1][0];
+      out.varyings[1] = a[1][1];
+      break;
+    }
+  case ProgramKind::Sprite:
+    {
+      const float px = a[0][0] * PositionRange * 0.5 * (a[4][0] / SpriteSizeScale);
+      const float py = a[0][1] * PositionRange * 0.5 * (a[4][1] / SpriteSizeScale);
+      const float c = std::cos(a[3][0]);
+      const float s = std::sin(a[3][0]);
+      out.x = (a[2][0] + u[0] + c * px - s * py) * u[2];
+      out.y = (a[2][1] + u[1] + s * px + c * py) * u[3];
+      out.varyings[0] = mix(a[5][0], a[5][2], a[1][0]);
+      out.varyings[1] = mix(a[5][1], a[5][3], a[1][1]);
+      out.varyings[2] = a[6][0] + u[4];
+      out.varyings[3] = a[6][1] + u[5];
+      out.varyings[4] = a[6][2] + u[6];
+      break;
+    }
+  case ProgramKind::Shape:
+    {
+      const float cornerX = a[0][0] * PositionRange;
+      const float cornerY = a[0][1] * PositionRange;
+      const float* ends = a[1];
+      const float* params = a[2];
+      const float margin = params[0] * 0.5 + 0.1;
+
+      float posX, posY;
+
+      if(params[1] == KindLine)
+      {
+        const float dx = ends[2] - ends[0];
+        const float dy = ends[3] - ends[1];
+        const float len = std::sqrt(dx * dx + dy * dy);
+        const float axisX = len > 0 ? dx / len : 1;
+        const float axisY = len > 0 ? dy / len : 0;
+        const float along = cornerX * (len * 0.5 + margin);
+        const float across = cornerY * margin;
+        posX = (ends[0] + ends[2]) * 0.5 + axisX * along - axisY * across;
+        posY = (ends[1] + ends[3]) * 0.5 + axisY * along + axisX * across;
+      }
+      else
+      {
+        float minX, minY, maxX, maxY;
+
+        if(params[1] == KindCircle)
+        {
+          minX = ends[0] - ends[2];
+          minY = ends[1] - ends[2];
+          maxX = ends[0] + ends[2];
+          maxY = ends[1] + ends[2];
+        }
+        else
+        {
+          minX = std::min(ends[0], ends[2]);
+          minY = std::min(ends[1], ends[3]);
+          maxX = std::max(ends[0], ends[2]);
+          maxY = std::max(ends[1], ends[3]);
+        }
+
+        posX = mix(minX - margin, maxX + margin, cornerX * 0.5 + 0.5);
+        posY = mix(minY - margin, maxY + margin, cornerY * 0.5 + 0.5);
+      }
+
+      out.x = (posX + u[0]) * u[2];
+      out.y = (posY + u[1]) * u[3];
+      out.varyings[0] = posX;
+      out.varyings[1] = posY;
+
+      // flat
+      for(int i = 0; i < 4; ++i)
+        out.varyings[2 + i] = ends[i];
+
+      out.varyings[6] = params[0];
+      out.varyings[7] = params[1];
+
+      for(int i = 0; i < 4; ++i)
+        out.varyings[8 + i] = a[3][i];
+
+      break;
+    }
+  case ProgramKind::Tilemap:
+    {
+      out.x = a[0][0] * PositionRange;
+      out.y = a[0][1] * PositionRange;
+      out.varyings[0] = out.x / u[2] - u[0];
+      out.varyings[1] = out.y / u[3] - u[1];
+      break;
+    }
+  }
+}
+
+// the varyings after these ones are 'flat'
+int smoothVaryingCount(ProgramKind kind)
+{
+  switch(kind)
+  {
+  case ProgramKind::Standard: return 2;
+  case ProgramKind::Sprite: return 5;
+  case ProgramKind::Shape: return 2;
+  case ProgramKind::Tilemap: return 2;
+  }
+
+  return 0;
+}
+
+int varyingCount(ProgramKind kind)
+{
+  return kind == ProgramKind::Shape ? 12 : smoothVaryingCount(kind);
+}
+
+float segmentDistance(float px, float py, const float* ends)
+{
+  const float pax = px - ends[0];
+  const float pay = py - ends[1];
+  const float bax = ends[2] - ends[0];
+  const float bay = ends[3] - ends[1];
+  const float h = ::clamp((pax * bax + pay * bay) / std::max(bax * bax + bay * bay, 1e-8f), 0.0f, 1.0f);
+  return std::hypot(pax - bax * h, pay - bay * h);
+}
+
+float boxOutlineDistance(float px, float py, const float* ends)
+{
+  const float minX = std::min(ends[0], ends[2]);
+  const float minY = std::min(ends[1], ends[3]);
+  const float maxX = std::max(ends[0], ends[2]);
+  const float maxY = std::max(ends[1], ends[3]);
+  const float dx = std::abs(px - (minX + maxX) * 0.5f) - (maxX - minX) * 0.5f;
+  const float dy = std::abs(py - (minY + maxY) * 0.5f) - (maxY - minY) * 0.5f;
+  return std::abs(std::hypot(std::max(dx, 0.0f), std::max(dy, 0.0f)) + std::min(std::max(dx, dy), 0.0f));
+}
+
+// signed distance to the edge of the stroke of a shape
+float shapeEdge(float px, float py, const float* v)
+{
+  const float* ends = v + 2;
+  const float thickness = v[6];
+  const float kind = v[7];
+
+  float dist;
+
+  if(kind == KindLine)
+    dist = segmentDistance(px, py, ends);
+  else if(kind == KindCircle)
+    dist = std::abs(std::hypot(px - ends[0], py - ends[1]) - ends[2]);
+  else
+    dist = boxOutlineDistance(px, py, ends);
+
+  return dist - thickness * 0.5f;
+}
+
+struct SoftGraphicsBackend : IGraphicsBackend
+{
+  SoftGraphicsBackend(Vec2i resolution) : m_screen(m_units)
+  {
+    m_screen.create(resolution, TextureFormat::Rgba8);
+    setRenderTarget(nullptr);
+  }
+
+  void setFullscreen(bool) override {}
+  void setCaption(String) override {}
+  void enableGrab(bool) override {}
+  bool setVsync(bool) override { return false; }
+  void makeCurrent(bool) override {}
+  int getRefreshRate() override { return 0; }
+
+  // RGBA, the top row first
+  void readPixels(Span<uint8_t> dstRgbPixels) override
+  {
+    const auto size = m_screen.size;
+    const int rowSize = size.x * 4;
+
+    if(dstRgbPixels.len < rowSize * size.y)
+      throw Error("readPixels: buffer too small");
+
+    for(int y = 0; y < size.y; ++y)
+      memcpy(dstRgbPixels.data + y * rowSize, m_screen.texelAddress(0, size.y - 1 - y), rowSize);
+  }
+
+  std::unique_ptr<ITexture> createTexture() override
+  {
+    return std::make_unique<SoftTexture>(m_units);
+  }
+
+  std::unique_ptr<IVertexBuffer> createVertexBuffer() override
+  {
+    return std::make_unique<SoftVertexBuffer>();
+  }
+
+  std::unique_ptr<IFrameBuffer> createFrameBuffer(Vec2i resolution, bool) override
+  {
+    return std::make_unique<SoftFrameBuffer>(resolution, m_units);
+  }
+
+  std::unique_ptr<IGpuProgram> createGpuProgram(String name_, bool) override
+  {
+    const std::string name(name_.data, name_.len);
+
+    if(name == "standard")
+      return std::make_unique<SoftProgram>(ProgramKind::Standard);
+
+    if(name == "sprite")
+      return std::make_unique<SoftProgram>(ProgramKind::Sprite);
+
+    if(name == "shape")
+      return std::make_unique<SoftProgram>(ProgramKind::Shape);
+
+    if(name == "tilemap")
+      return std::make_unique<SoftProgram>(ProgramKind::Tilemap);
+
+    char buffer[256];
+    throw Error(format(buffer, "No software implementation of program '%s'", name.c_str()));
+  }
+
+  void setSamplerUnit(IGpuProgram* iprogram, String name_, int unit) override
+  {
+    auto program = static_cast<SoftProgram*>(iprogram);
+    const std::string name(name_.data, name_.len);
+
+    if(name == "DiffuseTextureSampler")
+      program->samplerUnits[DiffuseTextureSampler] = unit;
+    else if(name == "TileIndices")
+      program->samplerUnits[TileIndices] = unit;
+    else if(name == "TilePalette")
+      program->samplerUnits[TilePalette] = unit;
+    else
+    {
+      char buffer[256];
+      throw Error(format(buffer, "No such sampler: '%s'", name.c_str()));
+    }
+  }
+
+  void setScreenSizeListener(IScreenSizeListener* listener) override
+  {
+    listener->onScreenSizeChanged(m_screen.size, Rect2i { { 0, 0 }, m_screen.size });
+  }
+
+  void setRenderTarget(IFrameBuffer* ifb) override
+  {
+    auto fb = static_cast<SoftFrameBuffer*>(ifb);
+    m_target = fb ? &fb->color : &m_screen;
+  }
+
+  void useGpuProgram(IGpuProgram* iprogram) override
+  {
+    m_program = static_cast<SoftProgram*>(iprogram);
+
+    // the attributes of the previous program might not be fed anymore
+    for(auto& attr : m_attributes)
+      attr.enabled = false;
+  }
+
+  void useVertexBuffer(IVertexBuffer* ivb) override
+  {
+    m_vertexBuffer = static_cast<SoftVertexBuffer*>(ivb);
+  }
+
+  void enableVertexAttribute(int id, int dim, int stride, int offset, AttributeType type, bool normalized) override
+  {
+    setAttribute(id, dim, stride, offset, type, normalized, 0);
+  }
+
+  void enableInstanceAttribute(int id, int dim, int stride, int offset, AttributeType type, bool normalized) override
+  {
+    setAttribute(id, dim, stride, offset, type, normalized, 1);
+  }
+
+  void setUniformBlock(void* ptr, size_t size) override
+  {
+    if(size > sizeof m_uniforms)
+      throw Error("Uniform block too big");
+
+    memset(m_uniforms, 0, sizeof m_uniforms);
+    memcpy(m_uniforms, ptr, size);
+  }
+
+  void draw(int vertexCount, int firstVertex) override
+  {
+    drawTriangles(vertexCount, firstVertex, 0);
+  }
+
+  void drawInstanced(int vertexCount, int instanceCount) override
+  {
+    for(int instance = 0; instance < instanceCount; ++instance)
+      drawTriangles(vertexCount, 0, instance);
+  }
+
+  void clear() override
+  {
+    for(int y = 0; y < m_target->size.y; ++y)
+      for(int x = 0; x < m_target->size.x; ++x)
+        m_target->store(x, y, { 0, 0, 0, 1 });
+  }
+
+  void swap() override {}
+
+private:
+  void setAttribute(int id, int dim, int stride, int offset, AttributeType type, bool normalized, int divisor)
+  {
+    if(id < 0 || id >= MaxAttributes)
+      throw Error("Vertex attribute out of range");
+
+    auto& attr = m_attributes[id];
+    attr.enabled = true;
+    attr.vb = m_vertexBuffer;
+    attr.dim = dim;
+    attr.stride = stride;
+    attr.offset = offset;
+    attr.type = type;
+    attr.normalized = normalized;
+    attr.divisor = divisor;
+  }
+
+  static void fetchAttribute(const Attribute& attr, int index, float out[4])
+  {
+    out[0] = out[1] = out[2] = 0;
+    out[3] = 1;
+
+    if(!attr.enabled)
+      return;
+
+    int componentSize = 4;
+
+    switch(attr.type)
+    {
+    case AttributeType::Float: componentSize = 4; break;
+    case AttributeType::Short: componentSize = 2; break;
+    case AttributeType::UnsignedShort: componentSize = 2; break;
+    case AttributeType::Byte: componentSize = 1; break;
+    case AttributeType::UnsignedByte: componentSize = 1; break;
+    }
+
+    const size_t start = attr.offset + index * attr.stride;
+
+    if(start + attr.dim * componentSize > attr.vb->bytes.size())
+      throw Error("Vertex attribute out of the buffer");
+
+    auto p = attr.vb->bytes.data() + start;
+
+    for(int i = 0; i < attr.dim; ++i)
+    {
+      switch(attr.type)
+      {
+      case AttributeType::Float:
+        memcpy(&out[i], p + i * 4, 4);
+        break;
+      case AttributeType::Short:
+        {
+          int16_t val;
+          memcpy(&val, p + i * 2, 2);
+          out[i] = attr.normalized ? std::max(val / 32767.0f, -1.0f) : val;
+          break;
+        }
+      case AttributeType::UnsignedShort:
+        {
+          uint16_t val;
+          memcpy(&val, p + i * 2, 2);
+          out[i] = attr.normalized ? val / 65535.0f : val;
+          break;
+        }
+      case AttributeType::Byte:
+        {
+          const auto val = (int8_t)p[i];
+          out[i] = attr.normalized ? std::max(val / 127.0f, -1.0f) : val;
+          break;
+        }
+      case AttributeType::UnsignedByte:
+        out[i] = attr.normalized ? p[i] / 255.0f : p[i];
+        break;
+      }
+    }
+  }
+
+  void drawTriangles(int vertexCount, int firstVertex, int instance)
+  {
+    for(int i = 0; i + 3 <= vertexCount; i += 3)
+    {
+      ShadedVertex v[3];
+
+      for(int k = 0; k < 3; ++k)
+      {
+        float attribs[MaxAttributes][4];
+
+        for(int id = 0; id < MaxAttributes; ++id)
+        {
+          auto& attr = m_attributes[id];
+          fetchAttribute(attr, attr.divisor ? instance / attr.divisor : firstVertex + i + k, attribs[id]);
+        }
+
+        shadeVertex(m_program->kind, attribs, m_uniforms, v[k]);
+      }
+
+      drawTriangle(v[0], v[1], v[2]);
+    }
+  }
+
+  // edge function: positive if 'p' is on the left of 'a' -> 'b'
+  static float edge(Vec2f a, Vec2f b, Vec2f p)
+  {
+    return (b.x - a.x) * (p.y - a.y) - (b.y - a.y) * (p.x - a.x);
+  }
+
+  // pixels exactly on a shared edge belong to only one of the triangles
+  static bool isTopLeft(Vec2f a, Vec2f b)
+  {
+    return (a.y == b.y && b.x < a.x) || b.y < a.y;
+  }
+
+  void drawTriangle(const ShadedVertex& v0, const ShadedVertex& v1, const ShadedVertex& v2)
+  {
+    const auto kind = m_program->kind;
+    const int smoothCount = smoothVaryingCount(kind);
+    const int count = varyingCount(kind);
+
+    // to window space: the frame buffer is the whole viewport
+    auto toWindow = [&] (const ShadedVertex& v)
+      {
+        return Vec2f((v.x + 1) * 0.5f * m_target->size.x, (v.y + 1) * 0.5f * m_target->size.y);
+      };
+
+    const ShadedVertex* sv[3] = { &v0, &v1, &v2 };
+    Vec2f p[3] = { toWindow(v0), toWindow(v1), toWindow(v2) };
+
+    float area = edge(p[0], p[1], p[2]);
+
+    if(area == 0)
+      return;
+
+    // counter-clockwise, no culling
+    if(area < 0)
+    {
+      std::swap(p[1], p[2]);
+      std::swap(sv[1], sv[2]);
+      area = -area;
+    }
+
+    const int minX = std::max(0, (int)std::floor(std::min({ p[0].x, p[1].x, p[2].x })));
+    const int minY = std::max(0, (int)std::floor(std::min({ p[0].y, p[1].y, p[2].y })));
+    const int maxX = std::min(m_target->size.x, (int)std::ceil(std::max({ p[0].x, p[1].x, p[2].x })));
+    const int maxY = std::min(m_target->size.y, (int)std::ceil(std::max({ p[0].y, p[1].y, p[2].y })));
+
+    // the varyings are affine in window space: their derivatives are constant
+    float dvdx[MaxVaryings];
+    float dvdy[MaxVaryings];
+
+    {
+      const float dw0dx = -(p[2].y - p[1].y) / area;
+      const float dw0dy = (p[2].x - p[1].x) / area;
+      const float dw1dx = -(p[0].y - p[2].y) / area;
+      const float dw1dy = (p[0].x - p[2].x) / area;
+      const float dw2dx = -(p[1].y - p[0].y) / area;
+      const float dw2dy = (p[1].x - p[0].x) / area;
+
+      for(int k = 0; k < smoothCount; ++k)
+      {
+        dvdx[k] = sv[0]->varyings[k] * dw0dx + sv[1]->varyings[k] * dw1dx + sv[2]->varyings[k] * dw2dx;
+        dvdy[k] = sv[0]->varyings[k] * dw0dy + sv[1]->varyings[k] * dw1dy + sv[2]->varyings[k] * dw2dy;
+      }
+
+      for(int k = smoothCount; k < count; ++k)
+        dvdx[k] = dvdy[k] = 0;
+    }
+
+    const bool topLeft0 = isTopLeft(p[1], p[2]);
+    const bool topLeft1 = isTopLeft(p[2], p[0]);
+    const bool topLeft2 = isTopLeft(p[0], p[1]);
+
+    float varyings[MaxVaryings];
+
+    // flat varyings come from the last vertex
+    for(int k = smoothCount; k < count; ++k)
+      varyings[k] = v2.varyings[k];
+
+    for(int y = minY; y < maxY; ++y)
+    {
+      for(int x = minX; x < maxX; ++x)
+      {
+        const Vec2f center(x + 0.5f, y + 0.5f);
+        const float e0 = edge(p[1], p[2], center);
+        const float e1 = edge(p[2], p[0], center);
+        const float e2 = edge(p[0], p[1], center);
+
+        if(e0 < 0 || e1 < 0 || e2 < 0)
+          continue;
+
+        if((e0 == 0 && !topLeft0) || (e1 == 0 && !topLeft1) || (e2 == 0 && !topLeft2))
+          continue;
+
+        const float w0 = e0 / area;
+        const float w1 = e1 / area;
+        const float w2 = e2 / area;
+
+        for(int k = 0; k < smoothCount; ++k)
+          varyings[k] = sv[0]->varyings[k] * w0 + sv[1]->varyings[k] * w1 + sv[2]->varyings[k] * w2;
+
+        Texel color;
+
+        if(shadeFragment(varyings, dvdx, dvdy, color))
+          blend(x, y, color);
+      }
+    }
+  }
+
+  const SoftTexture& sampler(SamplerSlot slot) const
+  {
+    auto texture = m_units[m_program->samplerUnits[slot]];
+
+    if(!texture)
+      throw Error("No texture bound");
+
+    return *texture;
+  }
+
+  // the fragment shaders. Returns false if the fragment is discarded
+  bool shadeFragment(const float* v, const float* dvdx, const float* dvdy, Texel& color) const
+  {
+    const float* u = m_uniforms;
+
+    switch(m_program->kind)
+    {
+    case ProgramKind::Standard:
+      {
+        auto c = sampler(DiffuseTextureSampler).sample(v[0], v[1]);
+        color = { c.r + u[0], c.g + u[1], c.b + u[2], c.a + u[3] };
+        return true;
+      }
+    case ProgramKind::Sprite:
+      {
+        auto c = sampler(DiffuseTextureSampler).sample(v[0], v[1]);
+        color = { c.r + v[2], c.g + v[3], c.b + v[4], c.a };
+        return true;
+      }
+    case ProgramKind::Shape:
+      {
+        // 'fwidth', from the neighbour pixels
+        const float e = shapeEdge(v[0], v[1], v);
+        const float ex = shapeEdge(v[0] + dvdx[0], v[1] + dvdx[1], v);
+        const float ey = shapeEdge(v[0] + dvdy[0], v[1] + dvdy[1], v);
+        const float pixel = std::max(std::abs(ex - e) + std::abs(ey - e), 1e-5f);
+
+        color = { v[8], v[9], v[10], v[11] };
+        color.a *= ::clamp(0.5f - e / pixel, 0.0f, 1.0f);
+        return true;
+      }
+    case ProgramKind::Tilemap:
+      {
+        const int cellX = (int)std::floor(v[0]);
+        const int cellY = (int)std::floor(v[1]);
+        auto& indices = sampler(TileIndices);
+
+        if(cellX < 0 || cellY < 0 || cellX >= indices.size.x || cellY >= indices.size.y)
+          return false;
+
+        const int index = (int)indices.fetch(cellX, cellY).r;
+
+        if(index == 0)
+          return false;
+
+        auto rect = sampler(TilePalette).fetch(index - 1, 0);
+        auto c = sampler(DiffuseTextureSampler).sample(mix(rect.r, rect.b, fract(v[0])), mix(rect.g, rect.a, fract(v[1])));
+        color = { c.r + u[4], c.g + u[5], c.b + u[6], c.a };
+        return true;
+      }
+    }
+
+    return false;
+  }
+
+  // glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA)
+  void blend(int x, int y, Texel src)
+  {
+    // fixed-point targets clamp the fragment color
+    if(m_target->format == TextureFormat::Rgba8)
+    {
+      src.r = ::clamp(src.r, 0.0f, 1.0f);
+      src.g = ::clamp(src.g, 0.0f, 1.0f);
+      src.b = ::clamp(src.b, 0.0f, 1.0f);
+      src.a = ::clamp(src.a, 0.0f, 1.0f);
+    }
+
+    const auto dst = m_target->fetch(x, y);
+    const float a = src.a;
+
+    Texel r;
+    r.r = src.r * a + dst.r * (1 - a);
+    r.g = src.g * a + dst.g * (1 - a);
+    r.b = src.b * a + dst.b * (1 - a);
+    r.a = src.a * a + dst.a * (1 - a);
+    m_target->store(x, y, r);
+  }
+
+  SoftTexture* m_units[MaxTextureUnits] {};
+  SoftTexture m_screen;
+  SoftTexture* m_target = nullptr;
+  SoftProgram* m_program = nullptr;
+  SoftVertexBuffer* m_vertexBuffer = nullptr;
+  Attribute m_attributes[MaxAttributes];
+  float m_uniforms[MaxUniforms] {};
+};
+}
+
+IGraphicsBackend* createSoftwareGraphicsBackend(Vec2i resolution)
+{
+  return new SoftGraphicsBackend(resolution);
+}
+
@@ -0,0 +1,157 @@
+// Copyright (C) 2025 - Sebastien Alaiwan
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as
+// published by the Free Software Foundation, either version 3 of the
+// License, or (at your option) any later version.
+
+#include "sprite_batch.h"
+
+#include <cmath> // lround
+
+#include "base/util.h" // clamp
+
+#if defined(__SSE__)
+#include <xmmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+static_assert(sizeof(SpriteInstance) == 28, "SpriteInstance must be tightly packed");
+
+namespace
+{
+int16_t toFixed16(float val, float scale)
+{
+  return (int16_t)std::lround(::clamp(val * scale, -32767.0f, 32767.0f));
+}
+
+uint16_t toUnorm16(float val)
+{
+  return (uint16_t)std::lround(::clamp(val, 0.0f, 1.0f) * 65535);
+}
+
+int8_t toSnorm8(float val)
+{
+  return (int8_t)std::lround(::clamp(val, -1.0f, 1.0f) * 127);
+}
+
+void generateRange(const SpriteBatch& batch, const Matrix3f& m, float cameraAngle, SpriteInstance* out, int first, int last)
+{
+  for(int i = first; i < last; ++i)
+  {
+    auto& instance = out[i];
+
+    // same operation order as the SIMD path
+    instance.x = m[0][0] * batch.x[i] + m[0][1] * batch.y[i] + m[0][2];
+    instance.y = m[1][0] * batch.x[i] + m[1][1] * batch.y[i] + m[1][2];
+    instance.angle = batch.angle[i] - cameraAngle;
+    instance.attributes = batch.attributes[i];
+  }
+}
+}
+
+SpriteAttributes packSpriteAttributes(Vec2f halfSize, const Vec2f uv[2], const float light[3])
+{
+  SpriteAttributes r;
+  r.w = toFixed16(halfSize.x, SpriteSizeScale);
+  r.h = toFixed16(halfSize.y, SpriteSizeScale);
+  r.u0 = toUnorm16(uv[0].x);
+  r.v0 = toUnorm16(1 - uv[1].y);
+  r.u1 = toUnorm16(uv[1].x);
+  r.v1 = toUnorm16(1 - uv[0].y);
+  r.r = toSnorm8(light[0]);
+  r.g = toSnorm8(light[1]);
+  r.b = toSnorm8(light[2]);
+  r.unused = 0;
+  return r;
+}
+
+void SpriteBatch::push(Vec2f pos, Vec2f halfSize, float angle_, const Vec2f uv[2], const float light[3])
+{
+  x.push_back(pos.x);
+  y.push_back(pos.y);
+  angle.push_back(angle_);
+  attributes.push_back(packSpriteAttributes(halfSize, uv, light));
+}
+
+void SpriteBatch::append(const SpriteBatch& other)
+{
+  for(auto array : { &SpriteBatch::x, &SpriteBatch::y, &SpriteBatch::angle })
+  {
+    auto& dst = this->*array;
+    auto& src = other.*array;
+    dst.insert(dst.end(), src.begin(), src.end());
+  }
+
+  attributes.insert(attributes.end(), other.attributes.begin(), other.attributes.end());
+}
+
+void SpriteBatch::clear()
+{
+  for(auto array : { &x, &y, &angle })
+    array->clear();
+
+  attributes.clear();
+}
+
+void generateSpriteInstancesScalar(const SpriteBatch& batch, const Matrix3f& viewMatrix, float cameraAngle, SpriteInstance* out)
+{
+  generateRange(batch, viewMatrix, cameraAngle, out, 0, batch.size());
+}
+
+void generateSpriteInstances(const SpriteBatch& batch, const Matrix3f& m, float cameraAngle, SpriteInstance* out)
+{
+  const int count = batch.size();
+  int i = 0;
+
+  // the centers and the angles, for 4 sprites
+  float x4[4], y4[4], angle4[4];
+
+#if defined(__SSE__)
+  const __m128 m00 = _mm_set1_ps(m[0][0]);
+  const __m128 m01 = _mm_set1_ps(m[0][1]);
+  const __m128 m02 = _mm_set1_ps(m[0][2]);
+  const __m128 m10 = _mm_set1_ps(m[1][0]);
+  const __m128 m11 = _mm_set1_ps(m[1][1]);
+  const __m128 m12 = _mm_set1_ps(m[1][2]);
+  const __m128 camAngle = _mm_set1_ps(cameraAngle);
+
+  for(; i + 4 <= count; i += 4)
+  {
+    const __m128 x = _mm_loadu_ps(&batch.x[i]);
+    const __m128 y = _mm_loadu_ps(&batch.y[i]);
+
+    _mm_storeu_ps(x4, _mm_add_ps(_mm_add_ps(_mm_mul_ps(m00, x), _mm_mul_ps(m01, y)), m02));
+    _mm_storeu_ps(y4, _mm_add_ps(_mm_add_ps(_mm_mul_ps(m10, x), _mm_mul_ps(m11, y)), m12));
+    _mm_storeu_ps(angle4, _mm_sub_ps(_mm_loadu_ps(&batch.angle[i]), camAngle));
+
+    for(int k = 0; k < 4; ++k)
+      out[i + k] = { x4[k], y4[k], angle4[k], batch.attributes[i + k] };
+  }
+#elif defined(__ARM_NEON)
+  const float32x4_t m00 = vdupq_n_f32(m[0][0]);
+  const float32x4_t m01 = vdupq_n_f32(m[0][1]);
+  const float32x4_t m02 = vdupq_n_f32(m[0][2]);
+  const float32x4_t m10 = vdupq_n_f32(m[1][0]);
+  const float32x4_t m11 = vdupq_n_f32(m[1][1]);
+  const float32x4_t m12 = vdupq_n_f32(m[1][2]);
+  const float32x4_t camAngle = vdupq_n_f32(cameraAngle);
+
+  for(; i + 4 <= count; i += 4)
+  {
+    const float32x4_t x = vld1q_f32(&batch.x[i]);
+    const float32x4_t y = vld1q_f32(&batch.y[i]);
+
+    // No fused multiply-add, to match the scalar path.
+    vst1q_f32(x4, vaddq_f32(vaddq_f32(vmulq_f32(m00, x), vmulq_f32(m01, y)), m02));
+    vst1q_f32(y4, vaddq_f32(vaddq_f32(vmulq_f32(m10, x), vmulq_f32(m11, y)), m12));
+    vst1q_f32(angle4, vsubq_f32(vld1q_f32(&batch.angle[i]), camAngle));
+
+    for(int k = 0; k < 4; ++k)
+      out[i + k] = { x4[k], y4[k], angle4[k], batch.attributes[i + k] };
+  }
+#endif
+
+  // remaining sprites, or all of them without SIMD
+  generateRange(batch, m, cameraAngle, out, i, count);
+}
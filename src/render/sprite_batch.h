@@ -0,0 +1,62 @@
+// Copyright (C) 2025 - Sebastien Alaiwan
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as
+// published by the Free Software Foundation, either version 3 of the
+// License, or (at your option) any later version.
+
+// Batched vertex generation for sprites.
+// Sprites are accumulated as structure-of-arrays during the frame,
+// then turned into instances in one pass, several sprites at a time
+// when SIMD instructions are available (SSE, NEON).
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "matrix3.h"
+
+// Sizes are stored on 16 bits, in 1/SpriteSizeScale of a view space unit.
+// Must match the sprite vertex shader.
+const float SpriteSizeScale = 256;
+
+// The part of an instance that doesn't depend on the camera:
+// quantized once, when the sprite is pushed.
+struct SpriteAttributes
+{
+  int16_t w, h; // see 'SpriteSizeScale'
+  uint16_t u0, v0, u1, v1; // texture rect, flipped vertically, normalized to [0;1]
+  int8_t r, g, b, unused; // light, normalized to [-1;1]
+};
+
+SpriteAttributes packSpriteAttributes(Vec2f halfSize, const Vec2f uv[2], const float light[3]);
+
+// VBO format, instanced sprites: one per sprite
+struct SpriteInstance
+{
+  float x, y; // center, in view space
+  float angle;
+  SpriteAttributes attributes;
+};
+
+struct SpriteBatch
+{
+  std::vector<float> x, y; // center
+  std::vector<float> angle;
+  std::vector<SpriteAttributes> attributes;
+
+  int size() const { return (int)x.size(); }
+
+  void push(Vec2f pos, Vec2f halfSize, float angle, const Vec2f uv[2], const float light[3]);
+  void append(const SpriteBatch& other); // all the sprites of 'other', in one block
+  void clear();
+};
+
+// Writes one instance per sprite of 'batch' to 'out':
+// centers are moved to view space by 'viewMatrix' (rotation and translation),
+// and 'cameraAngle' is subtracted from the angles.
+void generateSpriteInstances(const SpriteBatch& batch, const Matrix3f& viewMatrix, float cameraAngle, SpriteInstance* out);
+
+// Reference implementation, one sprite at a time
+void generateSpriteInstancesScalar(const SpriteBatch& batch, const Matrix3f& viewMatrix, float cameraAngle, SpriteInstance* out);
+
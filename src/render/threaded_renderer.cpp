@@ -0,0 +1,218 @@
+// Copyright (C) 2023 - Sebastien Alaiwan
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as
+// published by the Free Software Foundation, either version 3 of the
+// License, or (at your option) any later version.
+
+// Runs another renderer on a dedicated thread, which owns the graphics context.
+// The calling thread only records the draw calls into a command list.
+// There are two command lists: while the calling thread records one frame,
+// the render thread sorts, builds the vertices, and submits the previous one.
+
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "base/error.h"
+#include "base/renderer.h"
+#include "command_list.h"
+#include "engine/graphics_backend.h"
+#include "misc/stats.h"
+
+namespace
+{
+struct ThreadedRenderer : IRenderer
+{
+  ThreadedRenderer(IGraphicsBackend* backend, std::function<IRenderer* ()> createRenderer) : m_backend(backend)
+  {
+    // the graphics context now belongs to the render thread
+    m_backend->makeCurrent(false);
+
+    m_thread = std::thread([this, createRenderer] () { renderThread(createRenderer); });
+
+    // wait for the renderer to be created, and forward potential errors
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_cv.wait(lock, [&] () { return m_started; });
+
+    if(!m_error.empty())
+    {
+      lock.unlock();
+      m_thread.join();
+      m_backend->makeCurrent(true);
+      throw Error(m_error);
+    }
+  }
+
+  ~ThreadedRenderer()
+  {
+    {
+      std::unique_lock<std::mutex> lock(m_mutex);
+      m_quit = true;
+      m_cv.notify_all();
+    }
+
+    m_thread.join();
+    m_backend->makeCurrent(true);
+  }
+
+  void loadModel(int id, String imagePath) override
+  {
+    m_recording.loadModel(id, imagePath);
+  }
+
+  void setCamera(Vec2f pos) override
+  {
+    m_recording.setCamera(pos);
+  }
+
+  void setAmbientLight(float ambientLight) override
+  {
+    m_recording.setAmbientLight(ambientLight);
+  }
+
+  void beginDraw() override
+  {
+    m_recording.beginDraw();
+  }
+
+  void drawSprite(const RenderSprite& sprite) override
+  {
+    m_recording.drawSprite(sprite);
+  }
+
+  void drawText(const RenderText& text) override
+  {
+    m_recording.drawText(text);
+  }
+
+  void drawCircle(const RenderCircle& circle) override
+  {
+    m_recording.drawCircle(circle);
+  }
+
+  void drawLine(const RenderLine& line) override
+  {
+    m_recording.drawLine(line);
+  }
+
+  void drawRect(const RenderRect& rect) override
+  {
+    m_recording.drawRect(rect);
+  }
+
+  void loadTileLayer(const RenderTileLayer& layer) override
+  {
+    m_recording.loadTileLayer(layer);
+  }
+
+  void drawTileLayer() override
+  {
+    m_recording.drawTileLayer();
+  }
+
+  // hands the recorded frame over to the render thread
+  void endDraw() override
+  {
+    std::unique_lock<std::mutex> lock(m_mutex);
+
+    // wait for the previous frame to be submitted
+    m_cv.wait(lock, [&] () { return !m_frameReady; });
+
+    if(!m_error.empty())
+      throw Error(m_error);
+
+    std::swap(m_recording, m_submitting);
+    m_recording.data.clear();
+    m_frameReady = true;
+
+    importStats(m_renderStats);
+
+    m_cv.notify_all();
+  }
+
+private:
+  void renderThread(std::function<IRenderer* ()> createRenderer)
+  {
+    std::unique_ptr<IRenderer> renderer;
+
+    try
+    {
+      m_backend->makeCurrent(true);
+      renderer.reset(createRenderer());
+    }
+    catch(Error const& e)
+    {
+      m_error.assign(e.message().data, e.message().len);
+    }
+
+    {
+      std::unique_lock<std::mutex> lock(m_mutex);
+      m_started = true;
+      m_cv.notify_all();
+    }
+
+    if(!renderer)
+      return;
+
+    std::vector<StatVal> stats;
+
+    while(1)
+    {
+      {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_cv.wait(lock, [&] () { return m_frameReady || m_quit; });
+
+        // the last submitted frame still gets rendered
+        if(!m_frameReady)
+          break;
+      }
+
+      // the calling thread doesn't touch 'm_submitting' until 'm_frameReady' is reset
+      try
+      {
+        executeCommands(m_submitting.data, renderer.get());
+        renderer->endDraw();
+      }
+      catch(Error const& e)
+      {
+        m_error.assign(e.message().data, e.message().len);
+      }
+
+      exportStats(stats);
+
+      {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_renderStats = stats;
+        m_frameReady = false;
+        m_cv.notify_all();
+      }
+    }
+
+    renderer.reset();
+    m_backend->makeCurrent(false);
+  }
+
+  IGraphicsBackend* const m_backend;
+  std::thread m_thread;
+
+  // protected by 'm_mutex'
+  std::mutex m_mutex;
+  std::condition_variable m_cv;
+  bool m_started = false;
+  bool m_frameReady = false;
+  bool m_quit = false;
+  std::string m_error;
+  std::vector<StatVal> m_renderStats;
+
+  CommandList m_recording; // owned by the calling thread
+  CommandList m_submitting; // owned by the render thread while 'm_frameReady' is set
+};
+}
+
+IRenderer* createThreadedRenderer(IGraphicsBackend* backend, std::function<IRenderer* ()> createRenderer)
+{
+  return new ThreadedRenderer(backend, createRenderer);
+}
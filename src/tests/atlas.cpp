@@ -0,0 +1,207 @@
+// Copyright (C) 2025 - Sebastien Alaiwan
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as
+// published by the Free Software Foundation, either version 3 of the
+// License, or (at your option) any later version.
+
+#include "render/atlas.h"
+#include "render/baked_atlas.h"
+#include "tests.h"
+
+#include <vector>
+
+namespace
+{
+bool overlap(Vec2i posA, Vec2i dimA, Vec2i posB, Vec2i dimB)
+{
+  return posA.x < posB.x + dimB.x && posB.x < posA.x + dimA.x
+         && posA.y < posB.y + dimB.y && posB.y < posA.y + dimA.y;
+}
+}
+
+unittest("Atlas: rectangles don't overlap")
+{
+  SkylinePacker packer({ 256, 256 });
+
+  std::vector<Vec2i> positions;
+  std::vector<Vec2i> dims;
+
+  for(int i = 0; i < 40; ++i)
+  {
+    const Vec2i dim = { 8 + (i * 7) % 40, 8 + (i * 13) % 30 };
+    Vec2i pos;
+    assertTrue(packer.insert(dim, pos));
+    assertTrue(pos.x >= 0 && pos.y >= 0 && pos.x + dim.x <= 256 && pos.y + dim.y <= 256);
+
+    for(int k = 0; k < (int)positions.size(); ++k)
+      assertTrue(!overlap(pos, dim, positions[k], dims[k]));
+
+    positions.push_back(pos);
+    dims.push_back(dim);
+  }
+}
+
+unittest("Atlas: fills the whole page")
+{
+  SkylinePacker packer({ 64, 64 });
+
+  Vec2i pos;
+
+  for(int i = 0; i < 16; ++i)
+    assertTrue(packer.insert({ 16, 16 }, pos));
+
+  assertEquals(64 * 64, packer.usedArea());
+  assertEquals(64 * 64, packer.coveredArea());
+  assertTrue(!packer.insert({ 1, 1 }, pos));
+}
+
+unittest("Atlas: too big")
+{
+  SkylinePacker packer({ 64, 64 });
+
+  Vec2i pos;
+  assertTrue(!packer.insert({ 65, 1 }, pos));
+  assertTrue(!packer.insert({ 1, 65 }, pos));
+  assertTrue(packer.insert({ 64, 64 }, pos));
+}
+
+unittest("Atlas: reset")
+{
+  SkylinePacker packer({ 64, 64 });
+
+  Vec2i pos;
+  assertTrue(packer.insert({ 64, 40 }, pos));
+  assertTrue(!packer.insert({ 64, 40 }, pos));
+
+  packer.reset();
+  assertEquals(0, packer.usedArea());
+  assertTrue(packer.insert({ 64, 40 }, pos));
+  assertEquals(0, pos.y);
+}
+
+unittest("Atlas: uneven skyline")
+{
+  SkylinePacker packer({ 64, 64 });
+
+  Vec2i pos;
+  assertTrue(packer.insert({ 32, 48 }, pos));
+  assertTrue(packer.insert({ 32, 16 }, pos));
+
+  // goes on top of the lowest part
+  assertTrue(packer.insert({ 32, 16 }, pos));
+  assertEquals(32, pos.x);
+  assertEquals(16, pos.y);
+
+  // spans both parts: rests on the highest
+  assertTrue(!packer.insert({ 64, 32 }, pos));
+  assertTrue(packer.insert({ 64, 16 }, pos));
+  assertEquals(48, pos.y);
+  assertEquals(64 * 64, packer.coveredArea());
+}
+
+unittest("Atlas: repacking moves what doesn't fit back")
+{
+  std::vector<SkylinePacker> pages(2, SkylinePacker({ 64, 64 }));
+
+  Vec2i pos;
+  assertTrue(pages[1].insert({ 64, 32 }, pos));
+
+  std::vector<AtlasPlacement> placements;
+  assertTrue(repackAtlasPage(pages, 0, { { 64, 40 }, { 64, 32 } }, 2, placements));
+
+  assertEquals(2, (int)placements.size());
+  assertEquals(0, placements[0].page);
+  assertEquals(0, placements[0].pos.y);
+  assertEquals(1, placements[1].page);
+  assertEquals(32, placements[1].pos.y);
+  assertEquals(64 * 40, pages[0].usedArea());
+  assertEquals(64 * 64, pages[1].usedArea());
+}
+
+unittest("Atlas: repacking a page while the other pages are full")
+{
+  std::vector<SkylinePacker> pages(2, SkylinePacker({ 64, 64 }));
+
+  Vec2i pos;
+  assertTrue(pages[0].insert({ 64, 16 }, pos));
+  assertTrue(pages[1].insert({ 64, 64 }, pos));
+
+  // nowhere to go: nothing changes
+  std::vector<AtlasPlacement> placements;
+  assertTrue(!repackAtlasPage(pages, 0, { { 64, 40 }, { 64, 32 } }, 2, placements));
+
+  assertEquals(2, (int)pages.size());
+  assertEquals(64 * 16, pages[0].usedArea());
+  assertEquals(64 * 64, pages[1].usedArea());
+  assertTrue(pages[0].insert({ 64, 48 }, pos));
+  assertEquals(16, pos.y);
+
+  // with room for one more page
+  pages[0].reset();
+  assertTrue(repackAtlasPage(pages, 0, { { 64, 40 }, { 64, 32 } }, 3, placements));
+
+  assertEquals(3, (int)pages.size());
+  assertEquals(2, placements[1].page);
+  assertEquals(0, placements[1].pos.y);
+  assertEquals(64 * 32, pages[2].usedArea());
+}
+
+unittest("Atlas: baked atlas round trip")
+{
+  BakedAtlasContent content;
+  content.pages.push_back({ { 2, 1 }, { 1, 2, 3, 4, 5, 6, 7, 8 } });
+
+  BakedFrame frame { 0, { 0.0f, 1.0f, 0.5f, 0.0f } };
+  content.models.push_back({ "res/a.model", { { frame, frame }, { frame } } });
+  content.models.push_back({ "res/bb.tiles", {} });
+
+  auto data = serializeBakedAtlas(content);
+  auto atlas = openBakedAtlas({ data.data(), (int)data.size() });
+
+  assertEquals(1, atlas.pages.len);
+  assertEquals(2, atlas.pages.data[0].width);
+  assertEquals(1, atlas.pages.data[0].height);
+  assertEquals(5, atlas.pixels(atlas.pages.data[0])[4]);
+  assertEquals(0, (int)(atlas.pages.data[0].pixelOffset % 4));
+
+  assertEquals(2, atlas.models.len);
+  auto path0 = atlas.path(atlas.models.data[0]);
+  auto path1 = atlas.path(atlas.models.data[1]);
+  assertEquals(std::string("res/a.model"), std::string(path0.data, path0.len));
+  assertEquals(std::string("res/bb.tiles"), std::string(path1.data, path1.len));
+  assertEquals(2, (int)atlas.models.data[0].actionCount);
+  assertEquals(0, (int)atlas.models.data[1].actionCount);
+
+  auto& action = atlas.actions.data[atlas.models.data[0].firstAction + 1];
+  assertEquals(1, (int)action.frameCount);
+  assertEquals(0.5f, atlas.frames.data[action.firstFrame].uv[2]);
+}
+
+unittest("Atlas: corrupted baked atlas")
+{
+  BakedAtlasContent content;
+  content.pages.push_back({ { 1, 1 }, { 1, 2, 3, 4 } });
+  content.models.push_back({ "res/a.model", { { BakedFrame { 0, {} } } } });
+
+  auto data = serializeBakedAtlas(content);
+
+  {
+    auto truncated = data;
+    truncated.pop_back();
+    assertThrown(openBakedAtlas({ truncated.data(), (int)truncated.size() }));
+  }
+
+  {
+    auto badMagic = data;
+    badMagic[0] ^= 1;
+    assertThrown(openBakedAtlas({ badMagic.data(), (int)badMagic.size() }));
+  }
+
+  {
+    // the frame points to a page that doesn't exist
+    auto badPage = data;
+    const int frameOffset = sizeof(BakedAtlasHeader) + sizeof(BakedPage) + sizeof(BakedModel) + sizeof(BakedAction);
+    badPage[frameOffset] = 7;
+    assertThrown(openBakedAtlas({ badPage.data(), (int)badPage.size() }));
+  }
+}
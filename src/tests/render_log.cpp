@@ -0,0 +1,220 @@
+// Copyright (C) 2025 - Sebastien Alaiwan
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as
+// published by the Free Software Foundation, either version 3 of the
+// License, or (at your option) any later version.
+
+#include <cstdio> // remove
+#include <cstring> // memcpy
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "base/renderer.h"
+#include "misc/file.h"
+#include "render/command_list.h"
+#include "render/render_log.h"
+
+#include "tests.h"
+
+IRenderer* createRecordingRenderer(IRenderer* renderer, String path, Vec2i resolution);
+
+namespace
+{
+const std::string LogPath = "render_log_test.tmp";
+
+// logs the calls it receives
+struct MockRenderer : IRenderer
+{
+  MockRenderer(std::string& log) : log(log) {}
+
+  void loadModel(int id, String path) override { log += "load(" + std::to_string(id) + "," + std::string(path.data, path.len) + ");"; }
+  void setCamera(Vec2f pos) override { log += "camera(" + std::to_string((int)pos.x) + ");"; }
+  void setAmbientLight(float light) override { log += "light(" + std::to_string((int)(light * 10)) + ");"; }
+  void beginDraw() override { log += "begin;"; }
+  void endDraw() override { log += "end;"; }
+  void drawSprite(const RenderSprite& s) override { log += "sprite(" + std::to_string(s.modelId) + ");"; }
+  void drawText(const RenderText& t) override { log += "text(" + std::string(t.text.data, t.text.len) + ");"; }
+  void drawCircle(const RenderCircle& c) override { log += "circle(" + std::to_string((int)c.radius) + ");"; }
+  void drawLine(const RenderLine& l) override { log += "line(" + std::to_string((int)l.b.x) + ");"; }
+  void drawRect(const RenderRect& r) override { log += "rect(" + std::to_string((int)r.pos[1].y) + ");"; }
+  void loadTileLayer(const RenderTileLayer& l) override { log += "layer(" + std::to_string(l.size.x * l.size.y) + "," + std::to_string(l.tiles.data[2]) + ");"; }
+  void drawTileLayer() override { log += "tiles;"; }
+
+  std::string& log;
+};
+
+void drawFrames(IRenderer* renderer)
+{
+  renderer->loadModel(3, "res/hero.model");
+
+  const int tiles[] = { 1, 2, 3, 4 };
+  RenderTileLayer layer {};
+  layer.size = { 2, 2 };
+  layer.tiles = tiles;
+  renderer->loadTileLayer(layer);
+
+  renderer->setAmbientLight(0.5);
+  renderer->setCamera({ 7, 0 });
+  renderer->beginDraw();
+  renderer->drawTileLayer();
+
+  RenderSprite sprite {};
+  sprite.modelId = 3;
+  renderer->drawSprite(sprite);
+
+  RenderText text {};
+  text.text = "HELLO";
+  renderer->drawText(text);
+  renderer->endDraw();
+
+  renderer->setCamera({ 8, 0 });
+  renderer->beginDraw();
+
+  RenderCircle circle {};
+  circle.radius = 2;
+  renderer->drawCircle(circle);
+
+  RenderLine line {};
+  line.b = { 5, 0 };
+  renderer->drawLine(line);
+
+  RenderRect rect {};
+  rect.pos[1] = { 0, 6 };
+  renderer->drawRect(rect);
+  renderer->endDraw();
+}
+
+std::string recordFrames()
+{
+  std::string log;
+
+  {
+    std::unique_ptr<IRenderer> recorder(createRecordingRenderer(new MockRenderer(log), LogPath, { 240, 160 }));
+    drawFrames(recorder.get());
+  }
+
+  auto data = File::read(LogPath);
+  remove(LogPath.c_str());
+  return data;
+}
+}
+
+unittest("RenderLog: recorded frames replay the same calls")
+{
+  std::string expected;
+
+  {
+    MockRenderer renderer(expected);
+    drawFrames(&renderer);
+  }
+
+  auto data = recordFrames();
+  auto log = openRenderLog({ (const uint8_t*)data.data(), (int)data.size() });
+
+  assertEquals(240, log.resolution.x);
+  assertEquals(160, log.resolution.y);
+  assertEquals(2, (int)log.frames.size());
+
+  std::string replayed;
+  MockRenderer renderer(replayed);
+
+  for(auto frame : log.frames)
+  {
+    executeCommands(frame, &renderer);
+    renderer.endDraw();
+  }
+
+  assertEquals(expected, replayed);
+}
+
+unittest("RenderLog: skipped frames only set the renderer state")
+{
+  auto data = recordFrames();
+  auto log = openRenderLog({ (const uint8_t*)data.data(), (int)data.size() });
+
+  std::string replayed;
+  MockRenderer renderer(replayed);
+  executeCommands(log.frames[0], &renderer, false);
+
+  assertEquals(std::string("load(3,res/hero.model);layer(4,3);light(5);camera(7);"), replayed);
+}
+
+unittest("RenderLog: corrupted log")
+{
+  auto data = recordFrames();
+
+  {
+    auto truncated = data;
+    truncated.pop_back();
+    assertThrown(openRenderLog({ (const uint8_t*)truncated.data(), (int)truncated.size() }));
+  }
+
+  {
+    auto badMagic = data;
+    badMagic[0] ^= 1;
+    assertThrown(openRenderLog({ (const uint8_t*)badMagic.data(), (int)badMagic.size() }));
+  }
+
+  {
+    // the first frame claims to hold more commands than it does
+    auto log = openRenderLog({ (const uint8_t*)data.data(), (int)data.size() });
+    auto frame = log.frames[0];
+    frame.len -= 3;
+
+    std::string replayed;
+    MockRenderer renderer(replayed);
+    assertThrown(executeCommands(frame, &renderer));
+  }
+}
+
+unittest("RenderLog: corrupted sizes in commands")
+{
+  std::string replayed;
+  MockRenderer renderer(replayed);
+
+  auto execute = [&] (const std::vector<uint8_t>& data)
+    {
+      executeCommands({ data.data(), (int)data.size() }, &renderer);
+    };
+
+  {
+    // a negative string length
+    CommandList list;
+    list.loadModel(3, "res/hero.model");
+
+    const int len = -1;
+    memcpy(list.data.data() + 1 + sizeof(int), &len, sizeof len);
+    assertThrown(execute(list.data));
+  }
+
+  const int tiles[] = { 1, 2, 3, 4 };
+  RenderTileLayer layer {};
+  layer.size = { 2, 2 };
+  layer.tiles = tiles;
+
+  // the tile count, as stored in a command
+  auto withTileCount = [&] (Vec2i size, int count)
+    {
+      CommandList list;
+      list.loadTileLayer(layer);
+
+      RenderTileLayer stored;
+      memcpy(&stored, list.data.data() + 1, sizeof stored);
+      stored.size = size;
+      stored.tiles.len = count;
+      memcpy(list.data.data() + 1, &stored, sizeof stored);
+      return list.data;
+    };
+
+  assertThrown(execute(withTileCount({ 2, 2 }, -4)));
+  assertThrown(execute(withTileCount({ 3, 3 }, 4)));
+
+  // more tiles than the list holds
+  assertThrown(execute(withTileCount({ 1, 1000 }, 1000)));
+
+  // the untouched command goes through
+  execute(withTileCount({ 2, 2 }, 4));
+  assertEquals(std::string("layer(4,3);"), replayed);
+}
+
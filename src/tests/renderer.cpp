@@ -0,0 +1,244 @@
+// Copyright (C) 2023 - Sebastien Alaiwan
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as
+// published by the Free Software Foundation, either version 3 of the
+// License, or (at your option) any later version.
+
+#include <cmath> // fabs
+#include <cstdio>
+#include <cstring> // memcmp
+#include <memory>
+#include <vector>
+
+#include "base/renderer.h"
+#include "engine/graphics_backend.h"
+#include "misc/file.h"
+#include "render/picture.h"
+#include "render/sprite_batch.h"
+
+#include "tests.h"
+
+IRenderer* createRenderer(IGraphicsBackend* gfxBackend, Vec2i internalResolution);
+
+namespace
+{
+struct NullTexture : ITexture
+{
+  void create(Vec2i, TextureFormat) override {}
+  void upload(PictureView, Vec2i) override {}
+  void uploadRaw(const void*, Vec2i, Vec2i) override {}
+  void setNoRepeat() override {}
+  void bind(int) override {}
+};
+
+struct NullVertexBuffer : IVertexBuffer
+{
+  void upload(const void*, size_t) override {}
+  int append(const void*, int, int) override { return 0; }
+};
+
+struct NullFrameBuffer : IFrameBuffer
+{
+  ITexture* getColorTexture() override { return &texture; }
+  NullTexture texture;
+};
+
+struct NullGpuProgram : IGpuProgram
+{
+};
+
+// counts the draw calls
+struct CountingGraphicsBackend : IGraphicsBackend
+{
+  void setFullscreen(bool) override {}
+  void setCaption(String) override {}
+  void enableGrab(bool) override {}
+  bool setVsync(bool) override { return true; }
+  void makeCurrent(bool) override {}
+  int getRefreshRate() override { return 0; }
+  void readPixels(Span<uint8_t>) override {}
+  std::unique_ptr<ITexture> createTexture() override { return std::make_unique<NullTexture>(); }
+  std::unique_ptr<IVertexBuffer> createVertexBuffer() override { return std::make_unique<NullVertexBuffer>(); }
+  std::unique_ptr<IFrameBuffer> createFrameBuffer(Vec2i, bool) override { return std::make_unique<NullFrameBuffer>(); }
+  std::unique_ptr<IGpuProgram> createGpuProgram(String, bool) override { return std::make_unique<NullGpuProgram>(); }
+  void setSamplerUnit(IGpuProgram*, String, int) override {}
+  void setScreenSizeListener(IScreenSizeListener*) override {}
+  void setRenderTarget(IFrameBuffer*) override {}
+  void useGpuProgram(IGpuProgram*) override {}
+  void useVertexBuffer(IVertexBuffer*) override {}
+  void enableVertexAttribute(int, int, int, int, AttributeType, bool) override {}
+  void enableInstanceAttribute(int, int, int, int, AttributeType, bool) override {}
+  void setUniformBlock(void*, size_t) override {}
+  void draw(int, int) override { ++drawCalls; }
+  void drawInstanced(int, int) override { ++drawCalls; }
+  void clear() override {}
+  void swap() override {}
+
+  int drawCalls = 0;
+};
+
+int countDrawCalls(int blinkingCount)
+{
+  CountingGraphicsBackend backend;
+  std::unique_ptr<IRenderer> renderer(createRenderer(&backend, { 320, 240 }));
+
+  // blinking sprites only get a different light on odd frames
+  for(int frame = 0; frame < 2; ++frame)
+  {
+    renderer->beginDraw();
+
+    for(int i = 0; i < 20; ++i)
+    {
+      RenderSprite s {};
+      s.pos = { i * 0.5f, 0 };
+      s.halfSize = { 1, 1 };
+      s.modelId = -1;
+      s.actionIdx = 'A';
+      s.blinking = i < blinkingCount;
+      renderer->drawSprite(s);
+    }
+
+    backend.drawCalls = 0;
+    renderer->endDraw();
+  }
+
+  return backend.drawCalls;
+}
+}
+
+// Requires the game data (the renderer loads the font), so it does nothing on a fresh checkout.
+unittest("Renderer: lighting doesn't break batches")
+{
+  if(!File::exists("res/font.model"))
+  {
+    printf("res/font.model not found, skipping\n");
+    return;
+  }
+
+  // one for the sprites, one to copy the internal framebuffer to the screen
+  assertEquals(2, countDrawCalls(0));
+  assertEquals(2, countDrawCalls(7));
+  assertEquals(2, countDrawCalls(20));
+}
+
+unittest("Renderer: a tile layer takes one draw call")
+{
+  if(!File::exists("res/font.model"))
+  {
+    printf("res/font.model not found, skipping\n");
+    return;
+  }
+
+  CountingGraphicsBackend backend;
+  std::unique_ptr<IRenderer> renderer(createRenderer(&backend, { 320, 240 }));
+
+  std::vector<int> tiles(400 * 200, 'A');
+  RenderTileLayer layer {};
+  layer.modelId = -1;
+  layer.size = { 400, 200 };
+  layer.tiles = tiles;
+  renderer->loadTileLayer(layer);
+
+  auto drawFrame = [&] (Vec2f cameraPos)
+    {
+      renderer->setCamera(cameraPos);
+      renderer->beginDraw();
+      renderer->drawTileLayer();
+      backend.drawCalls = 0;
+      renderer->endDraw();
+      return backend.drawCalls - 1; // minus the copy to the screen
+    };
+
+  // whatever the part of the layer on screen
+  assertEquals(1, drawFrame({ 0, 0 }));
+  assertEquals(1, drawFrame({ 16, 8 }));
+  assertEquals(1, drawFrame({ 200, 100 }));
+}
+
+unittest("Renderer: a debug overlay takes one draw call")
+{
+  if(!File::exists("res/font.model"))
+  {
+    printf("res/font.model not found, skipping\n");
+    return;
+  }
+
+  CountingGraphicsBackend backend;
+  std::unique_ptr<IRenderer> renderer(createRenderer(&backend, { 320, 240 }));
+
+  renderer->beginDraw();
+
+  // lines, circles and rects share the same program
+  for(int i = 0; i < 500; ++i)
+  {
+    RenderRect r {};
+    r.useWorldRefFrame = true;
+    r.pos[0] = { i * 0.1f, 0 };
+    r.pos[1] = { i * 0.1f + 1, 2 };
+    r.zOrder = 100;
+    renderer->drawRect(r);
+
+    RenderLine l {};
+    l.a = { 0, i * 0.01f };
+    l.b = { 3, 0 };
+    l.zOrder = 100;
+    renderer->drawLine(l);
+
+    RenderCircle c {};
+    c.pos = { 1, 1 };
+    c.radius = i * 0.01f;
+    c.zOrder = 100;
+    renderer->drawCircle(c);
+  }
+
+  backend.drawCalls = 0;
+  renderer->endDraw();
+
+  // one for the shapes, one to copy the internal framebuffer to the screen
+  assertEquals(2, backend.drawCalls);
+}
+
+unittest("Renderer: batched sprite vertices match the scalar path")
+{
+  SpriteBatch batch;
+
+  // not a multiple of the SIMD width, so the remainder gets tested too
+  for(int i = 0; i < 1003; ++i)
+  {
+    const Vec2f uv[2] = { { i * 0.001f, 0.25f }, { 0.5f, 1 - i * 0.0005f } };
+    const float light[3] = { 0.5f, i % 2 ? 0.4f : 1.0f, i * 0.001f };
+    batch.push({ i * 0.37f - 150, 80 - i * 0.11f }, { 1.0f + i % 5, 0.5f }, i * 0.01f, uv, light);
+  }
+
+  const auto viewMatrix = rotate(0.3) * translate({ -12.5, 7.25 });
+
+  std::vector<SpriteInstance> expected(batch.size());
+  generateSpriteInstancesScalar(batch, viewMatrix, 0.3, expected.data());
+
+  std::vector<SpriteInstance> actual(batch.size());
+  generateSpriteInstances(batch, viewMatrix, 0.3, actual.data());
+
+  auto near = [] (float a, float b) { return fabs(a - b) < 0.0001; };
+
+  for(int i = 0; i < batch.size(); ++i)
+  {
+    auto& e = expected[i];
+    auto& a = actual[i];
+    assertTrue(near(e.x, a.x) && near(e.y, a.y));
+    assertTrue(near(e.angle, a.angle));
+    assertTrue(memcmp(&e.attributes, &a.attributes, sizeof e.attributes) == 0);
+  }
+
+  // the texture rect gets flipped vertically
+  auto& first = expected[0].attributes;
+  assertEquals(0, int(first.v0));
+  assertEquals(49151, int(first.v1)); // 0.75
+  assertTrue(near(-0.3, expected[0].angle));
+
+  // quantized sizes and lights
+  assertEquals(256, int(first.w));
+  assertEquals(128, int(first.h));
+  assertEquals(64, int(first.r)); // 0.5
+  assertEquals(127, int(first.g));
+  assertEquals(0, int(first.b));
+}
@@ -0,0 +1,115 @@
+// Copyright (C) 2023 - Sebastien Alaiwan
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as
+// published by the Free Software Foundation, either version 3 of the
+// License, or (at your option) any later version.
+
+#include "misc/replay.h"
+
+#include "tests.h"
+
+namespace
+{
+Control makeControl(int tick)
+{
+  Control c {};
+  c.right = tick < 500;
+  c.jump = tick % 100 < 20;
+  c.fire = tick > 700;
+  return c;
+}
+
+bool operator == (Control a, Control b)
+{
+  return a.left == b.left && a.right == b.right && a.up == b.up && a.down == b.down
+         && a.start == b.start && a.fire == b.fire && a.jump == b.jump && a.dash == b.dash
+         && a.restart == b.restart && a.debug == b.debug;
+}
+}
+
+unittest("Replay: record and play back")
+{
+  const int N = 1000;
+
+  ReplayRecorder recorder(7, 1234);
+
+  for(int i = 0; i < N; ++i)
+    recorder.record(makeControl(i));
+
+  auto data = serializeReplay(recorder.finish());
+  auto replay = deserializeReplay(data);
+
+  assertEquals(7, replay.level);
+  assertEquals(1234u, replay.seed);
+  assertEquals(N, replay.tickCount);
+
+  // 1000 ticks, but only a few dozen input changes
+  assertTrue(data.size() < 200u);
+
+  ReplayPlayer player(replay);
+
+  for(int i = 0; i < N; ++i)
+  {
+    Control c;
+    assertTrue(player.next(c));
+    assertTrue(c == makeControl(i));
+  }
+
+  Control c;
+  assertTrue(!player.next(c));
+}
+
+unittest("Replay: long runs")
+{
+  ReplayRecorder recorder(-1, 0);
+
+  for(int i = 0; i < 100000; ++i)
+    recorder.record({});
+
+  auto replay = recorder.finish();
+  assertEquals(100000, replay.tickCount);
+
+  ReplayPlayer player(replay);
+  int count = 0;
+  Control c;
+
+  while(player.next(c))
+    ++count;
+
+  assertEquals(100000, count);
+}
+
+unittest("Replay: invalid file")
+{
+  std::vector<uint8_t> garbage(32, 0xAA);
+  assertThrown(deserializeReplay(garbage));
+}
+
+unittest("Replay: corrupt run length")
+{
+  auto play = [] (std::vector<uint8_t> runs)
+    {
+      Replay replay;
+      replay.runs = runs;
+
+      ReplayPlayer player(replay);
+      Control c;
+
+      while(player.next(c))
+      {
+      }
+    };
+
+  // continuation bits past 32 bits
+  assertThrown(play({ 0, 0, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0x01 }));
+
+  // empty run
+  assertThrown(play({ 0, 0, 0x00 }));
+
+  // a run length written on 5 bytes is still valid
+  Replay replay;
+  replay.runs = { 0, 0, 0x81, 0x80, 0x80, 0x80, 0x00 };
+  ReplayPlayer player(replay);
+  Control c;
+  assertTrue(player.next(c));
+}
@@ -0,0 +1,133 @@
+// Copyright (C) 2023 - Sebastien Alaiwan
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as
+// published by the Free Software Foundation, either version 3 of the
+// License, or (at your option) any later version.
+
+#include <cstdio>
+#include <memory>
+
+#include "base/scene.h"
+#include "entities/explosion.h"
+#include "gameplay/entity.h"
+#include "gameplay/load_quest.h"
+#include "gameplay/presenter.h"
+#include "gameplay/snapshot.h"
+#include "gameplay/state_machine.h"
+#include "misc/file.h"
+
+#include "tests.h"
+
+unittest("Snapshot: serializer roundtrip")
+{
+  std::vector<uint8_t> buffer;
+
+  {
+    int a = 123;
+    float b = 4.5;
+    Vec2f c = { 6, 7 };
+    Serializer s(buffer);
+    s.io(a, b, c);
+    assertEquals(16, s.tell());
+  }
+
+  int a = 0;
+  float b = 0;
+  Vec2f c = { 0, 0 };
+  Serializer s(Span<const uint8_t> { buffer });
+  s.io(a, b, c);
+
+  assertEquals(123, a);
+  assertEquals(4.5f, b);
+  assertEquals(6.0f, c.x);
+  assertEquals(7.0f, c.y);
+  assertThrown(s.io(a));
+}
+
+unittest("Snapshot: entity roundtrip")
+{
+  auto explosion = makeExplosion();
+
+  for(int i = 0; i < 10; ++i)
+    explosion->tick();
+
+  std::vector<uint8_t> buffer;
+  Serializer out(buffer);
+  explosion->serialize(out);
+
+  auto restored = makeExplosion();
+  Serializer in(Span<const uint8_t> { buffer });
+  restored->serialize(in);
+  assertEquals(out.tell(), in.tell());
+
+  std::vector<uint8_t> buffer2;
+  Serializer out2(buffer2);
+  restored->serialize(out2);
+  assertTrue(buffer == buffer2);
+}
+
+namespace
+{
+struct NullPresenter : IPresenter
+{
+  void sendActor(SpriteActor const &) override {}
+  void sendActor(TileActor const &) override {}
+  void sendActor(DebugRectActor const &) override {}
+  void preload(Resource) override {}
+  void textBox(String) override {}
+  void playMusic(MUSIC) override {}
+  void stopMusic() override {}
+  void playSound(SOUND) override {}
+  void setCameraPos(Vec2f) override {}
+  void setAmbientLight(float) override {}
+  void loadTileLayer(MODEL, int, const Matrix2<int>&) override {}
+  void drawTileLayer() override {}
+  void flushFrame() override {}
+};
+}
+
+// Requires the game data, so it does nothing on a fresh checkout.
+// For the cost of a save/restore cycle, see 'benchsnapshot'.
+unittest("Snapshot: all rooms roundtrip")
+{
+  if(!File::exists("res/quest.gz"))
+  {
+    printf("res/quest.gz not found, skipping\n");
+    return;
+  }
+
+  NullPresenter presenter;
+  std::vector<uint8_t> first, second, third;
+
+  const int roomCount = (int)loadQuest("res/quest.gz").rooms.size();
+
+  for(int level = 0; level < roomCount; ++level)
+  {
+    std::unique_ptr<Scene> scene(createPlayingStateAtLevel(&presenter, level));
+    auto snapshotable = dynamic_cast<Snapshotable*>(scene.get());
+    assertTrue(snapshotable != nullptr);
+
+    Control noInput {};
+
+    for(int i = 0; i < 10; ++i)
+      scene->tick(noInput);
+
+    first.clear();
+    snapshotable->saveState(first);
+    snapshotable->loadState(first);
+
+    second.clear();
+    snapshotable->saveState(second);
+    assertTrue(first == second);
+
+    // restoring into another room rebuilds the whole arena
+    std::unique_ptr<Scene> other(createPlayingStateAtLevel(&presenter, level == 0 ? 1 : 0));
+    other->tick(noInput);
+    auto otherSnapshotable = dynamic_cast<Snapshotable*>(other.get());
+    otherSnapshotable->loadState(first);
+
+    third.clear();
+    otherSnapshotable->saveState(third);
+    assertTrue(first == third);
+  }
+}
@@ -0,0 +1,409 @@
+// Copyright (C) 2025 - Sebastien Alaiwan
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as
+// published by the Free Software Foundation, either version 3 of the
+// License, or (at your option) any later version.
+
+#include <cstdio>
+#include <cstdlib> // abs
+#include <cstring> // memcmp
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "base/error.h"
+#include "base/renderer.h"
+#include "engine/graphics_backend.h"
+#include "misc/file.h"
+
+#include "tests.h"
+
+// set by the Makefile. The defaults assume the tests run from the repository root
+#ifndef GOLDEN_DIR
+#define GOLDEN_DIR "src/tests/golden"
+#endif
+
+#ifndef TESTS_OUTPUT_DIR
+#define TESTS_OUTPUT_DIR "."
+#endif
+
+IGraphicsBackend* createSoftwareGraphicsBackend(Vec2i resolution);
+IRenderer* createRenderer(IGraphicsBackend* gfxBackend, Vec2i internalResolution);
+
+namespace
+{
+const Vec2i Resolution = { 240, 160 };
+
+std::vector<uint8_t> readScreen(IGraphicsBackend& backend)
+{
+  std::vector<uint8_t> pixels(Resolution.x * Resolution.y * 4);
+  backend.readPixels(pixels);
+  return pixels;
+}
+
+// Golden images are binary PPMs, in 'src/tests/golden'.
+// A frame that doesn't match gets written to the build directory, for inspection.
+// Without its golden image, the check is skipped.
+void checkGolden(String name, const std::vector<uint8_t>& rgbaPixels)
+{
+  const std::string baseName(name.data, name.len);
+  const std::string path = GOLDEN_DIR "/" + baseName + ".ppm";
+  const std::string actualPath = TESTS_OUTPUT_DIR "/" + baseName + ".actual.ppm";
+
+  std::string ppm = "P6\n" + std::to_string(Resolution.x) + " " + std::to_string(Resolution.y) + "\n255\n";
+  const int headerSize = ppm.size();
+
+  for(size_t i = 0; i < rgbaPixels.size(); i += 4)
+    ppm.append((const char*)&rgbaPixels[i], 3);
+
+  // small differences are allowed: float rounding varies between compilers
+  auto matches = [&] (const std::string& golden)
+    {
+      if(golden.size() != ppm.size() || golden.compare(0, headerSize, ppm, 0, headerSize))
+        return false;
+
+      int differentPixels = 0;
+
+      for(size_t i = headerSize; i < ppm.size(); i += 3)
+      {
+        for(int k = 0; k < 3; ++k)
+        {
+          if(abs(golden[i + k] - ppm[i + k]) > 4)
+          {
+            ++differentPixels;
+            break;
+          }
+        }
+      }
+
+      return differentPixels <= Resolution.x * Resolution.y / 200;
+    };
+
+  if(!File::exists(path))
+  {
+    File::write(actualPath, { (const uint8_t*)ppm.data(), (int)ppm.size() });
+    printf("golden image '%s' not found, skipping (the frame was written to '%s')\n", path.c_str(), actualPath.c_str());
+    return;
+  }
+
+  if(!matches(File::read(path)))
+  {
+    File::write(actualPath, { (const uint8_t*)ppm.data(), (int)ppm.size() });
+
+    char buffer[512];
+    throw Error(format(buffer, "Frame doesn't match '%s', see '%s'", path.c_str(), actualPath.c_str()));
+  }
+}
+
+struct Vertex
+{
+  int16_t x, y; // clip space, divided by 16
+  int16_t u, v;
+};
+
+// The software backend, without the tilemap program:
+// the renderer has to fall back on tile chunks.
+struct NoTilemapBackend : IGraphicsBackend
+{
+  std::unique_ptr<IGraphicsBackend> backend { createSoftwareGraphicsBackend(Resolution) };
+  int instancedDraws = 0;
+
+  std::unique_ptr<IGpuProgram> createGpuProgram(String name, bool zTest) override
+  {
+    if(std::string(name.data, name.len) == "tilemap")
+      throw Error("Disabled by the test");
+
+    return backend->createGpuProgram(name, zTest);
+  }
+
+  void drawInstanced(int vertexCount, int instanceCount) override
+  {
+    ++instancedDraws;
+    backend->drawInstanced(vertexCount, instanceCount);
+  }
+
+  void setFullscreen(bool fs) override { backend->setFullscreen(fs); }
+  void setCaption(String caption) override { backend->setCaption(caption); }
+  void enableGrab(bool enable) override { backend->enableGrab(enable); }
+  bool setVsync(bool enable) override { return backend->setVsync(enable); }
+  void makeCurrent(bool current) override { backend->makeCurrent(current); }
+  int getRefreshRate() override { return backend->getRefreshRate(); }
+  void readPixels(Span<uint8_t> dst) override { backend->readPixels(dst); }
+  std::unique_ptr<ITexture> createTexture() override { return backend->createTexture(); }
+  std::unique_ptr<IVertexBuffer> createVertexBuffer() override { return backend->createVertexBuffer(); }
+  std::unique_ptr<IFrameBuffer> createFrameBuffer(Vec2i resolution, bool depth) override { return backend->createFrameBuffer(resolution, depth); }
+  void setSamplerUnit(IGpuProgram* program, String name, int unit) override { backend->setSamplerUnit(program, name, unit); }
+  void setScreenSizeListener(IScreenSizeListener* listener) override { backend->setScreenSizeListener(listener); }
+  void setRenderTarget(IFrameBuffer* fb) override { backend->setRenderTarget(fb); }
+  void useGpuProgram(IGpuProgram* program) override { backend->useGpuProgram(program); }
+  void useVertexBuffer(IVertexBuffer* vb) override { backend->useVertexBuffer(vb); }
+  void enableVertexAttribute(int id, int dim, int stride, int offset, AttributeType type, bool normalized) override { backend->enableVertexAttribute(id, dim, stride, offset, type, normalized); }
+  void enableInstanceAttribute(int id, int dim, int stride, int offset, AttributeType type, bool normalized) override { backend->enableInstanceAttribute(id, dim, stride, offset, type, normalized); }
+  void setUniformBlock(void* ptr, size_t size) override { backend->setUniformBlock(ptr, size); }
+  void draw(int vertexCount, int firstVertex) override { backend->draw(vertexCount, firstVertex); }
+  void clear() override { backend->clear(); }
+  void swap() override { backend->swap(); }
+};
+
+// a wall of letters, with holes
+std::vector<int> letterWall(Vec2i size)
+{
+  std::vector<int> tiles(size.x * size.y);
+
+  for(int i = 0; i < (int)tiles.size(); ++i)
+    tiles[i] = i % 5 ? 'A' + i % 26 : -1;
+
+  return tiles;
+}
+
+// a tile layer, bigger than the screen, seen from a non-integer position
+std::vector<uint8_t> drawTileLayerFrame(IGraphicsBackend& backend)
+{
+  std::unique_ptr<IRenderer> renderer(createRenderer(&backend, Resolution));
+
+  const auto tiles = letterWall({ 40, 24 });
+
+  RenderTileLayer layer {};
+  layer.modelId = -1;
+  layer.size = { 40, 24 };
+  layer.tiles = tiles;
+  renderer->loadTileLayer(layer);
+
+  renderer->setCamera({ 17.3, 9.6 });
+  renderer->setAmbientLight(-0.2);
+  renderer->beginDraw();
+  renderer->drawTileLayer();
+  renderer->endDraw();
+
+  return readScreen(backend);
+}
+}
+
+unittest("Software backend: the triangles of a quad don't overlap")
+{
+  std::unique_ptr<IGraphicsBackend> backend(createSoftwareGraphicsBackend(Resolution));
+
+  auto program = backend->createGpuProgram("standard", false);
+
+  // half-transparent red
+  auto texture = backend->createTexture();
+  const uint8_t texel[] = { 255, 0, 0, 128 };
+  texture->create({ 1, 1 });
+  texture->uploadRaw(texel, { 1, 1 });
+
+  // slightly bigger than the screen
+  const Vertex quad[] =
+  {
+    { -2100, -2100, 0, 0 }, { +2100, -2100, 0, 0 }, { +2100, +2100, 0, 0 },
+    { -2100, -2100, 0, 0 }, { +2100, +2100, 0, 0 }, { -2100, +2100, 0, 0 },
+  };
+
+  auto vbo = backend->createVertexBuffer();
+  vbo->upload(quad, sizeof quad);
+
+  backend->setRenderTarget(nullptr);
+  backend->clear();
+  backend->useGpuProgram(program.get());
+  backend->useVertexBuffer(vbo.get());
+  texture->bind(0);
+  backend->enableVertexAttribute(0, 2, sizeof(Vertex), offsetof(Vertex, x), AttributeType::Short, true);
+  backend->enableVertexAttribute(1, 2, sizeof(Vertex), offsetof(Vertex, u), AttributeType::Short, true);
+  float block[4] {};
+  backend->setUniformBlock(block, sizeof block);
+  backend->draw(6);
+
+  // each pixel got blended exactly once
+  auto pixels = readScreen(*backend);
+  int wrongPixels = 0;
+
+  for(size_t i = 0; i < pixels.size(); i += 4)
+  {
+    if(pixels[i] != 128 || pixels[i + 1] != 0 || pixels[i + 2] != 0)
+      ++wrongPixels;
+  }
+
+  assertEquals(0, wrongPixels);
+}
+
+// Requires the game data (the renderer loads the font), so it does nothing on a fresh checkout.
+unittest("Software backend: golden frame")
+{
+  if(!File::exists("res/font.model"))
+  {
+    printf("res/font.model not found, skipping\n");
+    return;
+  }
+
+  std::unique_ptr<IGraphicsBackend> backend(createSoftwareGraphicsBackend(Resolution));
+  std::unique_ptr<IRenderer> renderer(createRenderer(backend.get(), Resolution));
+
+  // drawn as a tilemap
+  const auto tiles = letterWall({ 16, 4 });
+
+  RenderTileLayer layer {};
+  layer.modelId = -1;
+  layer.size = { 16, 4 };
+  layer.tiles = tiles;
+  renderer->loadTileLayer(layer);
+
+  renderer->setCamera({ 7, 3 });
+  renderer->setAmbientLight(-0.2);
+  renderer->beginDraw();
+  renderer->drawTileLayer();
+
+  for(int i = 0; i < 6; ++i)
+  {
+    RenderSprite s {};
+    s.useWorldRefFrame = true;
+    s.zOrder = 10;
+    s.pos = { 2.0f + i * 2, 6 };
+    s.halfSize = { 0.5f + i * 0.1f, 0.5f + i * 0.1f };
+    s.angle = i * 0.3f;
+    s.modelId = -1;
+    s.actionIdx = '0' + i;
+    renderer->drawSprite(s);
+  }
+
+  RenderLine line {};
+  line.useWorldRefFrame = true;
+  line.zOrder = 20;
+  line.a = { 1, 1 };
+  line.b = { 13, 8 };
+  line.color = { 1, 0.5, 0, 1 };
+  renderer->drawLine(line);
+
+  RenderCircle circle {};
+  circle.useWorldRefFrame = true;
+  circle.zOrder = 20;
+  circle.pos = { 10, 3 };
+  circle.radius = 1.5;
+  circle.color = { 0, 1, 0, 0.8 };
+  circle.thickness = 0.3;
+  renderer->drawCircle(circle);
+
+  RenderRect rect {};
+  rect.useWorldRefFrame = true;
+  rect.zOrder = 20;
+  rect.pos[0] = { 0.5, 0.5 };
+  rect.pos[1] = { 4, 2.5 };
+  rect.color = { 0, 0.5, 1, 1 };
+  renderer->drawRect(rect);
+
+  RenderText text {};
+  text.zOrder = 30;
+  text.pos = { -6, 4 };
+  text.text = "GOLDEN";
+  renderer->drawText(text);
+
+  renderer->endDraw();
+
+  checkGolden("renderer-frame", readScreen(*backend));
+}
+
+// Requires the game data, like the golden frame.
+unittest("Software backend: tile chunks match the tilemap")
+{
+  if(!File::exists("res/font.model"))
+  {
+    printf("res/font.model not found, skipping\n");
+    return;
+  }
+
+  std::unique_ptr<IGraphicsBackend> backend(createSoftwareGraphicsBackend(Resolution));
+  const auto expected = drawTileLayerFrame(*backend);
+
+  NoTilemapBackend fallback;
+  const auto actual = drawTileLayerFrame(fallback);
+
+  // the fallback really got used
+  assertTrue(fallback.instancedDraws > 0);
+
+  int differentPixels = 0;
+
+  for(size_t i = 0; i < expected.size(); i += 4)
+  {
+    if(memcmp(&expected[i], &actual[i], 3))
+      ++differentPixels;
+  }
+
+  assertEquals(0, differentPixels);
+}
+
+// Requires the game data, like the golden frame.
+unittest("Software backend: lines follow their reference frame")
+{
+  if(!File::exists("res/font.model"))
+  {
+    printf("res/font.model not found, skipping\n");
+    return;
+  }
+
+  auto drawLineFrame = [] (Vec2f cameraPos, bool useWorldRefFrame, Vec2f offset)
+    {
+      std::unique_ptr<IGraphicsBackend> backend(createSoftwareGraphicsBackend(Resolution));
+      std::unique_ptr<IRenderer> renderer(createRenderer(backend.get(), Resolution));
+
+      renderer->setCamera(cameraPos);
+      renderer->beginDraw();
+
+      RenderLine line {};
+      line.useWorldRefFrame = useWorldRefFrame;
+      line.a = Vec2f(-3, -2) + offset;
+      line.b = Vec2f(4, 1) + offset;
+      line.color = { 1, 1, 1, 1 };
+      renderer->drawLine(line);
+
+      renderer->endDraw();
+
+      return readScreen(*backend);
+    };
+
+  const auto screenLine = drawLineFrame({ 0, 0 }, false, { 0, 0 });
+
+  int litPixels = 0;
+
+  for(size_t i = 0; i < screenLine.size(); i += 4)
+    litPixels += screenLine[i] > 0;
+
+  assertTrue(litPixels > 0);
+
+  // screen space lines ignore the camera
+  assertTrue(screenLine == drawLineFrame({ 5, 3 }, false, { 0, 0 }));
+
+  // world space lines get moved by the camera
+  assertTrue(screenLine == drawLineFrame({ 5, 3 }, true, { 5, 3 }));
+}
+
+unittest("Software backend: cached texts follow their changes")
+{
+  if(!File::exists("res/font.model"))
+  {
+    printf("res/font.model not found, skipping\n");
+    return;
+  }
+
+  std::unique_ptr<IGraphicsBackend> backend(createSoftwareGraphicsBackend(Resolution));
+  std::unique_ptr<IRenderer> renderer(createRenderer(backend.get(), Resolution));
+
+  auto drawFrame = [&] (String s, Vec2f pos, float ambientLight)
+    {
+      renderer->setAmbientLight(ambientLight);
+      renderer->beginDraw();
+
+      RenderText text {};
+      text.pos = pos;
+      text.text = s;
+      renderer->drawText(text);
+
+      renderer->endDraw();
+      return readScreen(*backend);
+    };
+
+  const auto hello = drawFrame("HELLO", { 0, 0 }, 0);
+
+  assertTrue(hello == drawFrame("HELLO", { 0, 0 }, 0));
+  assertTrue(hello != drawFrame("HELLP", { 0, 0 }, 0));
+  assertTrue(hello != drawFrame("HELLO", { 1, 0 }, 0));
+  assertTrue(hello != drawFrame("HELLO", { 0, 0 }, -0.5));
+  assertTrue(hello == drawFrame("HELLO", { 0, 0 }, 0));
+}
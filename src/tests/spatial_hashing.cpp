@@ -53,3 +53,17 @@ unittest("Spatial hashing: object spanning on multiple cells")
   assertEquals(std::vector<uintptr_t>{}, hs.getObjectsInRect(Rect2f({ 70, 15 }, { 1, 1 })));
 }
 
+
+unittest("Spatial hashing: clear")
+{
+  HashedSpace hs;
+
+  hs.putObject(Rect2f({ 8, 6 }, { 1, 1 }), 1234);
+  hs.putObject(Rect2f({ 10, 10 }, { 100, 20 }), 5678);
+  hs.clear();
+
+  assertEquals(std::vector<uintptr_t>{}, hs.getObjectsInRect(Rect2f({ 0, 0 }, { 200, 200 })));
+
+  hs.putObject(Rect2f({ 8, 6 }, { 1, 1 }), 1234);
+  assertEquals(std::vector<uintptr_t>{ 1234 }, hs.getObjectsInRect(Rect2f({ 7, 5 }, { 3, 3 })));
+}
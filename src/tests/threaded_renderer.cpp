@@ -0,0 +1,131 @@
+// Copyright (C) 2023 - Sebastien Alaiwan
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as
+// published by the Free Software Foundation, either version 3 of the
+// License, or (at your option) any later version.
+
+#include <functional>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "base/renderer.h"
+#include "engine/graphics_backend.h"
+
+#include "tests.h"
+
+IRenderer* createThreadedRenderer(IGraphicsBackend* gfxBackend, std::function<IRenderer* ()> createRenderer);
+
+namespace
+{
+struct NullGraphicsBackend : IGraphicsBackend
+{
+  void setFullscreen(bool) override {}
+  void setCaption(String) override {}
+  void enableGrab(bool) override {}
+  bool setVsync(bool) override { return true; }
+  void makeCurrent(bool current) override { currentThread = current ? std::this_thread::get_id() : std::thread::id(); }
+  int getRefreshRate() override { return 0; }
+  void readPixels(Span<uint8_t>) override {}
+  std::unique_ptr<ITexture> createTexture() override { return nullptr; }
+  std::unique_ptr<IVertexBuffer> createVertexBuffer() override { return nullptr; }
+  std::unique_ptr<IFrameBuffer> createFrameBuffer(Vec2i, bool) override { return nullptr; }
+  std::unique_ptr<IGpuProgram> createGpuProgram(String, bool) override { return nullptr; }
+  void setSamplerUnit(IGpuProgram*, String, int) override {}
+  void setScreenSizeListener(IScreenSizeListener*) override {}
+  void setRenderTarget(IFrameBuffer*) override {}
+  void useGpuProgram(IGpuProgram*) override {}
+  void useVertexBuffer(IVertexBuffer*) override {}
+  void enableVertexAttribute(int, int, int, int, AttributeType, bool) override {}
+  void enableInstanceAttribute(int, int, int, int, AttributeType, bool) override {}
+  void setUniformBlock(void*, size_t) override {}
+  void draw(int, int) override {}
+  void drawInstanced(int, int) override {}
+  void clear() override {}
+  void swap() override {}
+
+  std::thread::id currentThread = std::this_thread::get_id();
+};
+
+// logs the calls it receives
+struct MockRenderer : IRenderer
+{
+  MockRenderer(std::string& log, NullGraphicsBackend& backend) : log(log), backend(backend) {}
+
+  void loadModel(int id, String path) override { log += "load(" + std::to_string(id) + "," + std::string(path.data, path.len) + ");"; }
+  void setCamera(Vec2f pos) override { log += "camera(" + std::to_string((int)pos.x) + ");"; }
+  void setAmbientLight(float) override {}
+  void beginDraw() override { log += "begin;"; }
+  void drawSprite(const RenderSprite& s) override { log += "sprite(" + std::to_string(s.modelId) + ");"; }
+  void drawText(const RenderText& t) override { log += "text(" + std::string(t.text.data, t.text.len) + ");"; }
+  void drawCircle(const RenderCircle&) override {}
+  void drawLine(const RenderLine&) override {}
+  void drawRect(const RenderRect&) override {}
+  void loadTileLayer(const RenderTileLayer& l) override { log += "layer(" + std::to_string(l.size.x * l.size.y) + "," + std::to_string(l.tiles.data[2]) + ");"; }
+  void drawTileLayer() override { log += "tiles;"; }
+
+  void endDraw() override
+  {
+    log += "end;";
+
+    if(backend.currentThread != std::this_thread::get_id())
+      log += "WRONG THREAD;";
+  }
+
+  std::string& log;
+  NullGraphicsBackend& backend;
+};
+}
+
+unittest("ThreadedRenderer: commands are replayed in order, on the render thread")
+{
+  NullGraphicsBackend backend;
+  std::string log;
+
+  {
+    std::unique_ptr<IRenderer> renderer(createThreadedRenderer(&backend, [&] () { return new MockRenderer(log, backend); }));
+
+    assertTrue(backend.currentThread != std::this_thread::get_id());
+
+    renderer->loadModel(3, "hero.model");
+    renderer->beginDraw();
+    renderer->setCamera({ 7, 0 });
+
+    RenderSprite s {};
+    s.modelId = 3;
+    renderer->drawSprite(s);
+
+    {
+      // the text must be copied
+      std::string str = "hello";
+      RenderText t {};
+      t.text = str;
+      renderer->drawText(t);
+      str = "XXXXX";
+    }
+
+    {
+      // the tiles must be copied
+      std::vector<int> tiles = { 1, 2, 3, 4, 5, 6 };
+      RenderTileLayer layer {};
+      layer.size = { 3, 2 };
+      layer.tiles = tiles;
+      renderer->loadTileLayer(layer);
+      tiles[2] = 0;
+    }
+
+    renderer->drawTileLayer();
+    renderer->endDraw();
+
+    // the second 'endDraw' waits for the first frame to be submitted
+    renderer->beginDraw();
+    renderer->endDraw();
+    renderer->beginDraw();
+    renderer->endDraw();
+  }
+
+  // the last frame is rendered before the render thread exits
+  assertTrue(std::this_thread::get_id() == backend.currentThread);
+  assertEquals(std::string("load(3,hero.model);begin;camera(7);sprite(3);text(hello);layer(6,3);tiles;end;begin;end;begin;end;"), log);
+}
@@ -0,0 +1,84 @@
+// Copyright (C) 2023 - Sebastien Alaiwan
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as
+// published by the Free Software Foundation, either version 3 of the
+// License, or (at your option) any later version.
+
+#include "engine/tick_scheduler.h"
+
+#include "tests.h"
+
+namespace
+{
+int runFrame(TickScheduler& scheduler, int now, int freq, int tickCostMs = 0)
+{
+  int clock = now;
+  int count = 0;
+
+  scheduler.beginFrame(now);
+
+  while(scheduler.nextTick(freq, clock))
+  {
+    clock += tickCostMs;
+    ++count;
+  }
+
+  scheduler.endFrame(freq);
+  return count;
+}
+}
+
+unittest("TickScheduler: keeps up with the clock")
+{
+  TickScheduler scheduler;
+  scheduler.reset(0);
+
+  int total = 0;
+
+  for(int now = 16; now <= 1600; now += 16)
+    total += runFrame(scheduler, now, 100);
+
+  assertEquals(159, total);
+  assertEquals(0, scheduler.droppedTicks);
+}
+
+unittest("TickScheduler: stall, late ticks are dropped")
+{
+  TickScheduler scheduler;
+  scheduler.maxTicksPerFrame = 5;
+  scheduler.maxDebtTicks = 0;
+  scheduler.reset(0);
+
+  assertEquals(5, runFrame(scheduler, 1000, 100));
+  assertEquals(94, scheduler.droppedTicks);
+
+  // back to normal
+  assertEquals(2, runFrame(scheduler, 1016, 100));
+  assertEquals(0, scheduler.droppedTicks);
+}
+
+unittest("TickScheduler: stall, late ticks are carried over")
+{
+  TickScheduler scheduler;
+  scheduler.maxTicksPerFrame = 5;
+  scheduler.maxDebtTicks = 20;
+  scheduler.reset(0);
+
+  assertEquals(5, runFrame(scheduler, 1000, 100));
+  assertEquals(20, scheduler.deferredTicks);
+  assertEquals(74, scheduler.droppedTicks);
+
+  // the debt is paid over the next frames
+  assertEquals(5, runFrame(scheduler, 1001, 100));
+  assertEquals(16, scheduler.deferredTicks);
+}
+
+unittest("TickScheduler: tick budget")
+{
+  TickScheduler scheduler;
+  scheduler.tickBudgetMs = 12;
+  scheduler.reset(0);
+
+  // each tick takes 5ms: only 3 fit in the budget
+  assertEquals(3, runFrame(scheduler, 100, 100, 5));
+}
@@ -6,9 +6,13 @@
 
 #include "base/my_algorithm.h"
 #include "base/util.h"
+#include "misc/stats.h"
 #include "misc/util.h"
 #include "tests.h"
+#include <algorithm>
+#include <chrono>
 #include <cstring>
+#include <thread>
 #include <vector>
 
 template<>
@@ -159,3 +163,92 @@ unittest("Base: sort: random")
   assertEquals(expected, array);
 }
 
+namespace
+{
+std::vector<int> radixSortIndices(std::vector<uint64_t> keys)
+{
+  std::vector<my::KeyIndex> pairs, tmp(keys.size());
+
+  for(int i = 0; i < (int)keys.size(); ++i)
+    pairs.push_back({ keys[i], i });
+
+  my::radixSort(Span<my::KeyIndex>(pairs), Span<my::KeyIndex>(tmp));
+
+  std::vector<int> r;
+
+  for(auto& p : pairs)
+    r.push_back(p.index);
+
+  return r;
+}
+}
+
+unittest("Base: radixSort: simple")
+{
+  std::vector<int> expected = { 3, 0, 1, 4, 2 };
+  assertEquals(expected, radixSortIndices({ 0x300, 0x20000000000, 0xFF00000000000000, 0x1, 0x50000000000 }));
+}
+
+unittest("Base: radixSort: stable")
+{
+  std::vector<int> expected = { 1, 3, 5, 0, 2, 4 };
+  assertEquals(expected, radixSortIndices({ 7, 2, 7, 2, 7, 2 }));
+}
+
+unittest("Base: radixSort: empty")
+{
+  std::vector<int> expected = {};
+  assertEquals(expected, radixSortIndices({}));
+}
+
+unittest("Base: radixSort: same order as std::stable_sort")
+{
+  // few distinct keys, spread over all the bytes: most passes do something,
+  // and the stability matters
+  uint32_t seed = 1234;
+  auto random = [&] () { seed = seed * 1103515245 + 12345; return (int)(seed >> 16); };
+
+  std::vector<uint64_t> keys(10000);
+
+  for(auto& key : keys)
+    key = uint64_t(random() % 8) << (8 * (random() % 8));
+
+  std::vector<int> expected(keys.size());
+
+  for(int i = 0; i < (int)expected.size(); ++i)
+    expected[i] = i;
+
+  std::stable_sort(expected.begin(), expected.end(), [&] (int a, int b) { return keys[a] < keys[b]; });
+
+  assertTrue(expected == radixSortIndices(keys));
+}
+
+namespace
+{
+Gauge ggImportTest("import test");
+}
+
+unittest("Stats: imported values aren't smoothed again")
+{
+  float imported = 0;
+
+  // gauge values are per-thread: the main thread's ones are left alone
+  std::thread([&] ()
+  {
+    std::vector<StatVal> stats;
+    exportStats(stats);
+
+    stats[ggImportTest.index] = { ggImportTest.name, 10 };
+    importStats(stats);
+
+    // the previous value would still be in the average
+    std::this_thread::sleep_for(std::chrono::milliseconds(2));
+
+    stats[ggImportTest.index] = { ggImportTest.name, 20 };
+    importStats(stats);
+
+    imported = getStat(ggImportTest.index).val;
+  }).join();
+
+  assertEquals(20.0f, imported);
+}